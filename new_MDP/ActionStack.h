@@ -0,0 +1,221 @@
+#ifndef ACTIONSTACK_H
+#define ACTIONSTACK_H
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef linux
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/*
+Stack of policy layers (the best QState of every state at one horizon step) used by the naive method,
+which writes every layer in the forward pass and reads them back in reverse while executing.
+By default the layers live back to back in one memory buffer. After spill_to(directory) they are appended
+to a memory-mapped file in that directory instead (Linux only, the file is unlinked as soon as it is created),
+so the process keeps at most about two windows of layers resident whatever the horizon: with advise set,
+windows already written or already read are dropped from the mapping (MADV_DONTNEED) and the window read next
+is requested ahead of time (MADV_WILLNEED); the kernel writes dirty pages back to the file as needed.
+*/
+class ActionStack{
+public:
+    int layer_size = 0;           //states per layer
+    int count = 0;                //layers in the stack
+    int capacity = 0;             //layers that fit in the buffer or mapped file
+    vector<int> memory = {};      //layers when not spilling
+    int* mapped = NULL;           //mapping of the file when spilling
+    int fd = -1;                  //spill file, -1 when not spilling
+    string spill_directory = "";
+    bool advise = true;           //page-cache advice while spilling
+    size_t window_bytes = 16 << 20; //granularity of the page-cache advice, a multiple of the page size
+    size_t resident_end = 0;      //while reading back, bytes from here on are already dropped from the mapping
+
+    ActionStack(){}
+
+    ActionStack(const ActionStack&) = delete;
+    ActionStack& operator=(const ActionStack&) = delete;
+
+    ~ActionStack(){
+        _close();
+    }
+
+    /*
+    Makes the following reserve() calls keep the layers in a memory-mapped file in the given directory.
+    An empty directory keeps them in memory. The space of the file is allocated when it is sized, so a directory
+    that cannot hold it (missing, not writable or full) stops the process with an error instead of silently
+    keeping the layers in memory; a platform without mmap prints a warning and keeps them in memory.
+    No output.
+    */
+    void spill_to(string directory, bool page_cache_advice = true){
+        spill_directory = directory;
+        advise = page_cache_advice;
+    }
+
+    /*
+    Empties the stack and prepares room for the given number of layers; more layers can still be pushed.
+    Takes as input the expected number of layers and the number of states of a layer.
+    No output.
+    */
+    void reserve(int layers, int states){
+        _close();
+        layer_size = states;
+        count = 0;
+        capacity = max(1, layers);
+#ifdef linux
+        if (!spill_directory.empty()){
+            string path = spill_directory + "/naive_actions_XXXXXX";
+            vector<char> name(path.begin(), path.end());
+            name.push_back('\0');
+            fd = mkstemp(name.data());
+            if (fd < 0){
+                cerr << "ActionStack: cannot create a spill file in " << spill_directory << ": " << strerror(errno) << endl;
+                exit(1);
+            }
+            unlink(name.data()); //removed by the system when closed
+            _map(capacity);
+            if (mapped == NULL){
+                cerr << "ActionStack: cannot map a spill file of " << _mapped_bytes(capacity) << " bytes in " << spill_directory << ": " << strerror(errno) << endl;
+                exit(1);
+            }
+            return;
+        }
+#else
+        if (!spill_directory.empty())
+            cerr << "ActionStack: spilling needs mmap, keeping the layers in memory" << endl;
+#endif
+        memory.assign((size_t)capacity * layer_size, 0);
+    }
+
+    void push(const vector<int> &layer){
+        if (layer_size == 0 && count == 0) reserve(capacity, layer.size());
+        if (count == capacity) _grow();
+        copy(layer.begin(), layer.end(), _layer(count));
+        count++;
+        resident_end = _mapped_bytes(capacity);
+#ifdef linux
+        if (mapped != NULL && advise){ //drop the windows just completed, the kernel writes them back
+            size_t done = _window_start(_offset(count));
+            size_t prev = _window_start(_offset(count - 1));
+            if (done > prev)
+                madvise((char*)mapped + prev, done - prev, MADV_DONTNEED);
+        }
+#endif
+    }
+
+    //best QState of a state in the top layer
+    int top(int state_num){
+        return _layer(count - 1)[state_num];
+    }
+
+    //best QState of a state in layer i, counted from the bottom of the stack
+    int at(int i, int state_num){
+        return _layer(i)[state_num];
+    }
+
+    //copies the top layer into layer
+    void top(vector<int> &layer){
+        int* first = _layer(count - 1);
+        layer.assign(first, first + layer_size);
+    }
+
+    void pop(){
+        count--;
+#ifdef linux
+        if (mapped != NULL && advise){ //every byte from _offset(count) on is popped
+            size_t w = _window_start(_offset(count));
+            if (w + window_bytes < resident_end){ //entered a lower window: drop the ones above, prefetch the one below
+                madvise((char*)mapped + w + window_bytes, resident_end - w - window_bytes, MADV_DONTNEED);
+                resident_end = w + window_bytes;
+                if (w > 0)
+                    madvise((char*)mapped + w - window_bytes, window_bytes, MADV_WILLNEED);
+            }
+        }
+#endif
+    }
+
+    bool empty(){
+        return count == 0;
+    }
+
+    int size(){
+        return count;
+    }
+
+    bool spilling(){
+        return mapped != NULL;
+    }
+
+    int* _layer(int i){
+        if (mapped != NULL) return mapped + (size_t)i * layer_size;
+        return memory.data() + (size_t)i * layer_size;
+    }
+
+    //byte offset of layer i in the spill file
+    size_t _offset(int i){
+        return (size_t)i * layer_size * sizeof(int);
+    }
+
+    size_t _window_start(size_t byte){
+        return byte / window_bytes * window_bytes;
+    }
+
+    size_t _mapped_bytes(int layers){
+        return max((size_t)1, (size_t)layers * layer_size * sizeof(int));
+    }
+
+    void _grow(){
+        if (fd < 0){
+            capacity = 2 * capacity;
+            memory.resize((size_t)capacity * layer_size);
+            return;
+        }
+#ifdef linux
+        munmap(mapped, _mapped_bytes(capacity));
+        mapped = NULL;
+        capacity = 2 * capacity;
+        _map(capacity);
+        if (mapped == NULL){
+            cerr << "ActionStack: cannot extend the spill file in " << spill_directory << ": " << strerror(errno) << endl;
+            exit(1);
+        }
+#endif
+    }
+
+    //sizes the spill file for the given number of layers and maps it, mapped stays NULL (errno set) on failure
+    void _map(int layers){
+#ifdef linux
+        size_t bytes = _mapped_bytes(layers);
+        int e = posix_fallocate(fd, 0, bytes); //allocated now: a full disk fails here rather than with SIGBUS on a write
+        if (e != 0){
+            errno = e;
+            return;
+        }
+        void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) return;
+        mapped = (int*)p;
+        if (advise) madvise(mapped, bytes, MADV_SEQUENTIAL);
+#endif
+    }
+
+    void _close(){
+#ifdef linux
+        if (mapped != NULL) munmap(mapped, _mapped_bytes(capacity));
+        if (fd >= 0) close(fd);
+#endif
+        mapped = NULL;
+        fd = -1;
+        memory.clear();
+        memory.shrink_to_fit();
+        count = 0;
+    }
+};
+#endif
@@ -0,0 +1,76 @@
+#ifndef BELLMANKERNEL_H
+#define BELLMANKERNEL_H
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BELLMAN_AVX2
+#include <immintrin.h>
+#endif
+
+/*
+Computes the Q-value of one row of a TransitionStore:
+    sum over k < n of  p[k] * (r[k] + gamma * V[successors[k] * stride])
+V is read with a stride so that both vector<float> (stride 1) and the .second of vector<pair<int,float>> (stride 2) can be used.
+The AVX2 kernel accumulates 8 lanes (k % 8) and adds them up as ((l0+l4)+(l2+l6))+((l1+l5)+(l3+l7));
+the scalar kernel follows the same order, so both return exactly the same value and results do not depend on the CPU.
+*/
+typedef float (*bellman_kernel)(const int* successors, const float* p, const float* r, int n, const float* V, int stride, float gamma);
+
+float bellman_backup_scalar(const int* successors, const float* p, const float* r, int n, const float* V, int stride, float gamma){
+    float lanes[8] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    for (int k = 0; k < n; k++){
+        float v = V[successors[k] * stride];
+        float t = gamma * v;
+        t = r[k] + t;
+        t = p[k] * t;
+        lanes[k % 8] = lanes[k % 8] + t;
+    }
+    return ((lanes[0] + lanes[4]) + (lanes[2] + lanes[6])) + ((lanes[1] + lanes[5]) + (lanes[3] + lanes[7]));
+}
+
+#ifdef BELLMAN_AVX2
+__attribute__((target("avx2")))
+float bellman_backup_avx2(const int* successors, const float* p, const float* r, int n, const float* V, int stride, float gamma){
+    __m256 acc = _mm256_setzero_ps();
+    __m256 g = _mm256_set1_ps(gamma);
+    __m256i s = _mm256_set1_epi32(stride);
+    int k = 0;
+    for (; k + 8 <= n; k += 8){
+        __m256i idx = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(successors + k)), s);
+        __m256 v = _mm256_i32gather_ps(V, idx, 4);
+        __m256 t = _mm256_add_ps(_mm256_loadu_ps(r + k), _mm256_mul_ps(g, v));
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(p + k), t));
+    }
+    if (k < n){ //last partial block, masked lanes add exactly 0
+        __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(n - k), lane);
+        __m256i idx = _mm256_mullo_epi32(_mm256_maskload_epi32(successors + k, mask), s);
+        __m256 v = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), V, idx, _mm256_castsi256_ps(mask), 4);
+        __m256 t = _mm256_add_ps(_mm256_maskload_ps(r + k, mask), _mm256_mul_ps(g, v));
+        __m256 prod = _mm256_mul_ps(_mm256_maskload_ps(p + k, mask), t);
+        acc = _mm256_add_ps(acc, _mm256_and_ps(prod, _mm256_castsi256_ps(mask)));
+    }
+    __m128 lo = _mm256_castps256_ps128(acc);
+    __m128 hi = _mm256_extractf128_ps(acc, 1);
+    __m128 sum4 = _mm_add_ps(lo, hi);                        //(l0+l4), (l1+l5), (l2+l6), (l3+l7)
+    __m128 sum2 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4)); //(l0+l4)+(l2+l6), (l1+l5)+(l3+l7)
+    __m128 sum1 = _mm_add_ss(sum2, _mm_shuffle_ps(sum2, sum2, 1));
+    return _mm_cvtss_f32(sum1);
+}
+#endif
+
+/*
+Picks the fastest kernel supported by the CPU running the program.
+AVX-512 is not used: rows hold a few tens of successors at most, and a 16 lane order would change the results.
+*/
+bellman_kernel select_bellman_kernel(){
+#ifdef BELLMAN_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return bellman_backup_avx2;
+#endif
+    return bellman_backup_scalar;
+}
+
+bellman_kernel bellman_backup = select_bellman_kernel();
+
+#endif
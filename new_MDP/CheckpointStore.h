@@ -0,0 +1,400 @@
+#ifndef CHECKPOINTSTORE_H
+#define CHECKPOINTSTORE_H
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <float.h>
+#include "ValueFunction.h"
+
+using namespace std;
+
+/*
+Encodings of the checkpoints of a CheckpointStore:
+checkpoint_full keeps float values and int best QStates (8 bytes per state), exactly;
+checkpoint_fp16 keeps the values as half floats around the middle of their range (3 bytes per state);
+checkpoint_quantized rounds every value to a whole number of steps of 2*max_error above an anchor checkpoint, so
+every value is restored within max_error (plus the rounding of the restored value to float), and keeps only the difference with the numbers of steps of the
+checkpoint below it on the stack, in 16 bits (3 bytes per state). Finite-horizon values grow with the time step
+while consecutive checkpoints differ little, so the differences fit where the values themselves would not.
+The anchor is the first checkpoint of the stack, or one whose differences do not fit: it is quantized above
+its minimum instead.
+The compressed encodings keep the best QStates in one byte, so they need fewer than 256 QStates per state.
+A checkpoint the lossy codec cannot encode within its bound (an anchor with a range wider than 65536 steps, or
+values farther than 65504 from the middle of their range for fp16) is kept in float instead (7 bytes per state),
+and is the anchor of the checkpoints above it.
+*/
+enum checkpoint_codec {checkpoint_full, checkpoint_fp16, checkpoint_quantized};
+
+const float HALF_MAX = 65504.0; //largest finite half float
+
+//float to IEEE half float, rounding to nearest even; values beyond the half range become the largest finite half
+uint16_t float_to_half(float f){
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    int exponent = (int)((x >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = x & 0x7fffff;
+    if (((x >> 23) & 0xff) == 0xff)
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    if (exponent >= 31)
+        return sign | 0x7bff;
+    if (exponent <= 0){ //subnormal half
+        if (exponent < -10) return sign;
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) half++;
+        return sign | half;
+    }
+    uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++;
+    if ((half & 0x7fff) >= 0x7c00) half = sign | 0x7bff;
+    return half;
+}
+
+float half_to_float(uint16_t h){
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    uint32_t x;
+    if (exponent == 0){
+        float f = mantissa / 16777216.0f; //subnormal, mantissa * 2^-24
+        return sign ? -f : f;
+    }
+    else if (exponent == 31)
+        x = sign | 0x7f800000 | (mantissa << 13);
+    else
+        x = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+/*
+Stack of value function checkpoints kept in one preallocated slab instead of one heap vector per checkpoint.
+reserve() sizes the slab for the largest number of checkpoints an algorithm keeps at once (about sqrt(H) for the
+root method, log2(H) for the tree method), push() encodes a value function into the next fixed slot and pop() only
+releases it, so the evaluators do not allocate while they run. If an algorithm pushes more checkpoints than
+reserved, the slab doubles. The peak number of slots in use is tracked exactly and gives the stack memory.
+With a lossy codec, worst_error holds the largest difference between a value pushed and the value restored, and
+full_slots counts the checkpoints kept in float because the codec could not meet its bound.
+checkpoint_quantized also keeps the top checkpoint decoded (its anchor and its numbers of steps above it): a push
+encodes against it, a pop of a difference slot subtracts the difference, which is exact in integers, and only the
+pop of an anchor decodes the slots below again, from their own anchor.
+*/
+class CheckpointStore{
+public:
+    checkpoint_codec codec = checkpoint_full;
+    float max_error = 0.01;        //error bound of checkpoint_quantized
+    float worst_error = 0.0;       //largest error of a restored value since the last reserve()
+    int num_states = 0;            //length of every checkpoint
+    int capacity = 0;              //slots in the slab
+    int count = 0;                 //slots in use
+    int peak = 0;                  //most slots in use since the last reserve()
+    vector<float> values = {};     //checkpoint_full: values of slot i at [i*num_states, (i+1)*num_states)
+    vector<int> best_qstates = {}; //checkpoint_full: best QStates of slot i, same layout
+    vector<uint16_t> codes = {};           //compressed codecs: encoded values, same layout
+    vector<unsigned char> best_codes = {}; //compressed codecs: best QStates, same layout
+    vector<float> slot_base = {};  //compressed codecs: value encoded as 0 in every slot
+    vector<float> slot_step = {};  //checkpoint_quantized: value of one quantization step in every slot
+    vector<char> slot_delta = {};  //checkpoint_quantized: slot kept as differences with the slot below
+    vector<int> slot_shift = {};   //checkpoint_quantized: smallest difference of a difference slot, added to its codes
+    vector<float> chain_anchor = {};//checkpoint_quantized: restored values of the anchor of the top slot
+    vector<int> chain_steps = {};  //checkpoint_quantized: steps of the top slot above chain_anchor
+    vector<int> delta_scratch = {};//checkpoint_quantized: steps of the slot being encoded
+    vector<char> slot_full = {};   //compressed codecs: slot kept in float, in full_values
+    vector<float> full_values = {};//compressed codecs: values of the slots kept in float, allocated on the first one
+    int full_slots = 0;            //slots kept in float since the last reserve()
+    size_t bytes = 0;              //bytes of the slots in use
+    size_t peak_bytes = 0;         //most bytes of slots in use since the last reserve()
+
+    /*
+    Empties the store and allocates the slab for the current codec.
+    Takes as input the number of slots and the number of states of the model.
+    No output.
+    */
+    void reserve(int slots, int numstates){
+        num_states = numstates;
+        capacity = max(1, slots);
+        count = 0;
+        peak = 0;
+        worst_error = 0.0;
+        full_slots = 0;
+        bytes = 0;
+        peak_bytes = 0;
+        size_t n = (codec == checkpoint_full) ? (size_t)capacity * num_states : 0;
+        size_t m = (codec == checkpoint_full) ? 0 : (size_t)capacity * num_states;
+        values.assign(n, 0.0);
+        best_qstates.assign(n, 0);
+        codes.assign(m, 0);
+        best_codes.assign(m, 0);
+        slot_base.assign(codec == checkpoint_full ? 0 : capacity, 0.0);
+        slot_step.assign(codec == checkpoint_full ? 0 : capacity, 0.0);
+        slot_full.assign(codec == checkpoint_full ? 0 : capacity, 0);
+        slot_delta.assign(codec == checkpoint_quantized ? capacity : 0, 0);
+        slot_shift.assign(codec == checkpoint_quantized ? capacity : 0, 0);
+        chain_anchor.assign(codec == checkpoint_quantized ? num_states : 0, 0.0);
+        chain_steps.assign(codec == checkpoint_quantized ? num_states : 0, 0);
+        full_values.clear();
+    }
+
+    void push(const ValueFunction &V){
+        if (count == 0 && num_states != V.size()) //never reserved, or reserved for another model
+            reserve(capacity, V.size());
+        if (count == capacity) _grow();
+        size_t offset = (size_t)count * num_states;
+        if (codec == checkpoint_full){
+            copy(V.values.begin(), V.values.end(), values.begin() + offset);
+            copy(V.best_qstates.begin(), V.best_qstates.end(), best_qstates.begin() + offset);
+        }
+        else
+            _encode(V, count);
+        bytes += _bytes(count);
+        count++;
+        peak = max(peak, count);
+        peak_bytes = max(peak_bytes, bytes);
+    }
+
+    /*
+    Restores the last checkpoint into V, reusing the arrays of V.
+    No output.
+    */
+    void top(ValueFunction &V) const{
+        size_t offset = (size_t)(count - 1) * num_states;
+        V.resize(num_states);
+        if (codec == checkpoint_full){
+            copy(values.begin() + offset, values.begin() + offset + num_states, V.values.begin());
+            copy(best_qstates.begin() + offset, best_qstates.begin() + offset + num_states, V.best_qstates.begin());
+            return;
+        }
+        for (int i = 0; i < num_states; i++){
+            if (codec == checkpoint_quantized)
+                V.values[i] = _chain_value(i);
+            else
+                V.values[i] = slot_full[count - 1] ? full_values[offset + i] : _decode(count - 1, codes[offset + i]);
+            V.best_qstates[i] = best_codes[offset + i];
+        }
+    }
+
+    //value of a state in the last checkpoint
+    float top_value(int state_num) const{
+        size_t pos = (size_t)(count - 1) * num_states + state_num;
+        if (codec == checkpoint_full)
+            return values[pos];
+        if (codec == checkpoint_quantized)
+            return _chain_value(state_num);
+        if (slot_full[count - 1])
+            return full_values[pos];
+        return _decode(count - 1, codes[pos]);
+    }
+
+    void pop(){
+        count--;
+        bytes -= _bytes(count);
+        if (codec != checkpoint_quantized || count == 0)
+            return;
+        if (slot_delta[count]){ //back to the steps of the slot below, exactly
+            size_t offset = (size_t)count * num_states;
+            for (int i = 0; i < num_states; i++)
+                chain_steps[i] -= slot_shift[count] + codes[offset + i];
+        }
+        else
+            _restore_chain(count - 1);
+    }
+
+    bool empty() const{
+        return count == 0;
+    }
+
+    int size() const{
+        return count;
+    }
+
+    void _grow(){
+        capacity = 2 * capacity;
+        if (codec == checkpoint_full){
+            values.resize((size_t)capacity * num_states);
+            best_qstates.resize((size_t)capacity * num_states);
+        }
+        else{
+            codes.resize((size_t)capacity * num_states);
+            best_codes.resize((size_t)capacity * num_states);
+            slot_base.resize(capacity);
+            slot_step.resize(capacity);
+            slot_full.resize(capacity);
+            if (codec == checkpoint_quantized){
+                slot_delta.resize(capacity);
+                slot_shift.resize(capacity);
+            }
+            if (!full_values.empty())
+                full_values.resize((size_t)capacity * num_states);
+        }
+    }
+
+    /*
+    Encodes V into a slot with the current lossy codec and updates worst_error with the error of every value.
+    checkpoint_quantized keeps the slot as differences with the top slot when they fit in 16 bits, as an anchor
+    otherwise. The slot is kept in float when the codec cannot meet its bound on these values.
+    No output.
+    */
+    void _encode(const ValueFunction &V, int slot){
+        size_t offset = (size_t)slot * num_states;
+        for (int i = 0; i < num_states; i++)
+            best_codes[offset + i] = V.best_qstates[i];
+        slot_full[slot] = 0;
+        if (codec == checkpoint_quantized){
+            slot_delta[slot] = 0;
+            if (slot > 0 && _encode_delta(V, slot))
+                return;
+        }
+        float lo = *min_element(V.values.begin(), V.values.end());
+        float hi = *max_element(V.values.begin(), V.values.end());
+        float step = 2 * max_error;
+        bool fits = (codec == checkpoint_fp16) ? (hi - lo) / 2 <= HALF_MAX
+                                               : (hi == lo || (step > 0.0 && (hi - lo) / step <= 65535.0));
+        float slot_error = 0.0;
+        bool within = true;
+        if (fits){
+            if (codec == checkpoint_fp16){
+                slot_base[slot] = lo + (hi - lo) / 2; //half floats are most precise near 0
+                for (int i = 0; i < num_states; i++)
+                    codes[offset + i] = float_to_half(V.values[i] - slot_base[slot]);
+            }
+            else{
+                slot_base[slot] = lo;
+                slot_step[slot] = step;
+                for (int i = 0; i < num_states; i++)
+                    codes[offset + i] = (hi > lo) ? (uint16_t)min(65535.0f, roundf((V.values[i] - lo) / step)) : 0;
+            }
+            for (int i = 0; i < num_states; i++){
+                float error = fabsf(_decode(slot, codes[offset + i]) - V.values[i]);
+                slot_error = max(slot_error, error);
+                within = within && _within_bound(error, V.values[i]);
+            }
+            fits = codec == checkpoint_fp16 || within;
+        }
+        if (!fits){
+            if (full_values.empty())
+                full_values.resize((size_t)capacity * num_states);
+            copy(V.values.begin(), V.values.end(), full_values.begin() + offset);
+            slot_full[slot] = 1;
+            slot_error = 0.0;
+            full_slots++;
+        }
+        worst_error = max(worst_error, slot_error);
+        if (codec == checkpoint_quantized) //the slot is the anchor of the ones pushed above it
+            _restore_chain(slot);
+    }
+
+    /*
+    checkpoint_quantized: rounds V to whole steps above the anchor of the top slot and keeps the differences with
+    the steps of the top slot in a slot, if they span at most 65535 steps and every value is restored within max_error.
+    Takes as input V and the slot, above the top one.
+    Returns false, leaving the top slot decoded, if the differences do not fit.
+    */
+    bool _encode_delta(const ValueFunction &V, int slot){
+        size_t offset = (size_t)slot * num_states;
+        float step = 2 * max_error;
+        if (step <= 0.0)
+            return false;
+        vector<int> &steps = delta_scratch;
+        steps.resize(num_states);
+        int lo = INT_MAX, hi = INT_MIN;
+        float slot_error = 0.0;
+        bool within = true;
+        for (int i = 0; i < num_states; i++){
+            double k = round((V.values[i] - chain_anchor[i]) / step);
+            if (fabs(k) > 1e9) //too far from the anchor for an int
+                return false;
+            steps[i] = (int)k;
+            int difference = steps[i] - chain_steps[i];
+            lo = min(lo, difference);
+            hi = max(hi, difference);
+            float error = fabsf(_step_value(chain_anchor[i], steps[i]) - V.values[i]);
+            slot_error = max(slot_error, error);
+            within = within && _within_bound(error, V.values[i]);
+        }
+        if ((long long)hi - lo > 65535 || !within)
+            return false;
+        for (int i = 0; i < num_states; i++)
+            codes[offset + i] = (uint16_t)(steps[i] - chain_steps[i] - lo);
+        slot_delta[slot] = 1;
+        slot_shift[slot] = lo;
+        chain_steps.swap(steps);
+        worst_error = max(worst_error, slot_error);
+        return true;
+    }
+
+    //checkpoint_quantized: decodes a slot into chain_anchor and chain_steps, from the anchor at or below it
+    void _restore_chain(int slot){
+        int anchor = slot;
+        while (slot_delta[anchor]) anchor--;
+        size_t offset = (size_t)anchor * num_states;
+        for (int i = 0; i < num_states; i++){
+            chain_anchor[i] = slot_full[anchor] ? full_values[offset + i] : _decode(anchor, codes[offset + i]);
+            chain_steps[i] = 0;
+        }
+        for (int s = anchor + 1; s <= slot; s++){
+            offset = (size_t)s * num_states;
+            for (int i = 0; i < num_states; i++)
+                chain_steps[i] += slot_shift[s] + codes[offset + i];
+        }
+    }
+
+    //checkpoint_quantized: whether a restored value meets the bound, allowing for its rounding to float
+    bool _within_bound(float error, float value) const{
+        return error <= max_error + fabsf(value) * FLT_EPSILON;
+    }
+
+    //checkpoint_quantized: value a number of steps above an anchor value (in double, the steps exceed the float mantissa)
+    float _step_value(float anchor, int steps) const{
+        return (float)(anchor + (double)(2 * max_error) * steps);
+    }
+
+    //checkpoint_quantized: restored value of a state in the top slot
+    float _chain_value(int state_num) const{
+        return _step_value(chain_anchor[state_num], chain_steps[state_num]);
+    }
+
+    float _decode(int slot, uint16_t code) const{
+        if (codec == checkpoint_fp16)
+            return slot_base[slot] + half_to_float(code);
+        return slot_base[slot] + code * slot_step[slot];
+    }
+
+    //bytes of a slot in use, more than slot_bytes() when it is kept in float
+    size_t _bytes(int slot) const{
+        if (codec != checkpoint_full && slot_full[slot])
+            return slot_bytes() + (size_t)num_states * sizeof(float);
+        return slot_bytes();
+    }
+
+    //bytes of one checkpoint
+    size_t slot_bytes() const{
+        if (codec == checkpoint_full)
+            return (size_t)num_states * (sizeof(float) + sizeof(int));
+        return (size_t)num_states * (sizeof(uint16_t) + sizeof(unsigned char)) + 2 * sizeof(float);
+    }
+
+    //bytes of the top checkpoint kept decoded by checkpoint_quantized
+    size_t _chain_bytes() const{
+        return (chain_anchor.size() + chain_steps.size() + delta_scratch.size()) * sizeof(float);
+    }
+
+    //bytes of the checkpoints held at the same time at the peak, with the decoded top one
+    size_t peak_memory() const{
+        return peak_bytes + (peak_bytes > 0 ? _chain_bytes() : 0);
+    }
+
+    //bytes held by the slab
+    size_t memory_used() const{
+        return capacity * slot_bytes() + full_values.size() * sizeof(float) + _chain_bytes();
+    }
+};
+#endif
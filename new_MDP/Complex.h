@@ -2,6 +2,8 @@
 #define COMPLEX_H
 #include <iostream>
 #include <math.h>
+#include <vector>
+#include <string>
 
 #ifdef _WIN32
 #include <nlohmann\json.hpp>
@@ -17,6 +19,13 @@ using json = nlohmann::json;
 
 using namespace std;
 
+//slots of ComplexScenario::measurements, in the order of measurement_names
+enum measurement_id {NUMBER_OF_VMS, RAM_SIZE, NUMBER_OF_CPUS, STORAGE_CAPACITY, PERC_FREE_RAM, PERC_CPU_USAGE,
+                     IO_PER_SEC, TOTAL_LOAD, READ_LOAD, TOTAL_LATENCY, NUM_MEASUREMENTS};
+
+const char* measurement_names[NUM_MEASUREMENTS] = {"number_of_VMs", "RAM_size", "number_of_CPUs", "storage_capacity", "perc_free_RAM",
+                                                   "perc_CPU_usage", "io_per_sec", "total_load", "%_read_load", "total_latency"};
+
 extern bool flag = true;
 
 double myRand(double LO, double HI){
@@ -37,51 +46,93 @@ public:
     int load_period;
     int MIN_VMS;
     int MAX_VMS;
-    json measurements;
+    double measurements[NUM_MEASUREMENTS];
 
     ComplexScenario(int trainingsteps=5000, int loadperiod=250, int initvms=10, int minvms=1, int maxvms=2){
         training_steps = trainingsteps;
         load_period = loadperiod;
         MIN_VMS = minvms;
         MAX_VMS = maxvms;
-        measurements = this->_get_measurements(initvms);
+        this->_get_measurements(initvms);
     }
 
+    //total_load is the incoming load: inserting the served load with json += never replaced the existing key
     json get_current_measurements(){
-        double load = measurements["total_load"];
-        double capacity = this->get_current_capacity();
-        double served_load = min(capacity, (double)load);
-
-        json curr_meas = measurements;
-        curr_meas += json::object_t::value_type("total_load", served_load);
+        json curr_meas = {
+            {"number_of_VMs", (int)measurements[NUMBER_OF_VMS]},
+            {"RAM_size", (int)measurements[RAM_SIZE]},
+            {"number_of_CPUs", (int)measurements[NUMBER_OF_CPUS]},
+            {"storage_capacity", (int)measurements[STORAGE_CAPACITY]},
+            {"perc_free_RAM", measurements[PERC_FREE_RAM]},
+            {"perc_CPU_usage", measurements[PERC_CPU_USAGE]},
+            {"io_per_sec", measurements[IO_PER_SEC]},
+            {"total_load", measurements[TOTAL_LOAD]},
+            {"%_read_load", measurements[READ_LOAD]},
+            {"total_latency", measurements[TOTAL_LATENCY]}
+        };
         return curr_meas;
     }
 
+    /*
+    Maps the names of the model parameters (MDPModel::index_params) to measurement slots, once before training.
+    Takes as input the parameter names.
+    Returns the measurement_id of every name, or -1 for names the scenario does not measure.
+    */
+    vector<int> get_measurement_layout(const vector<string> &names){
+        vector<int> layout;
+        for (auto& name:names){
+            int id = -1;
+            for (int i = 0; i < NUM_MEASUREMENTS; i++){
+                if (name == measurement_names[i]) id = i;
+            }
+            layout.push_back(id);
+        }
+        return layout;
+    }
+
+    /*
+    Same as get_current_measurements(), without building a json: fills values[i] with the measurement of layout[i].
+    Takes as input a layout from get_measurement_layout() and an array of layout.size() values.
+    No output.
+    */
+    void get_current_measurements(const vector<int> &layout, double* values){
+        for (int i = 0; i < layout.size(); i++){
+            if (layout[i] >= 0)
+                values[i] = measurements[layout[i]];
+            else
+                values[i] = 0.0;
+        }
+    }
+
     double execute_action(pair<string,int> &action){
-        time++;
-        int num_vms = measurements["number_of_VMs"];
-        string action_type = action.first;
-        int action_value = action.second;
+        int vm_change = 0;
+        if (action.first == "add_VMs")
+            vm_change = action.second;
+        if (action.first == "remove_VMs")
+            vm_change = -action.second;
+        return execute_action(vm_change);
+    }
 
-        if (action_type == "add_VMs")
-            num_vms += action_value;
-        if (action_type == "remove_VMs")
-            num_vms -= action_value;
+    //same as above, for an action given by the change in the number of VMs it causes (MDPModel::action_vm_change)
+    double execute_action(int vm_change){
+        time++;
+        int num_vms = measurements[NUMBER_OF_VMS];
+        num_vms += vm_change;
 
         if (num_vms < MIN_VMS)
             num_vms = MIN_VMS;
         if (num_vms > MAX_VMS)
             num_vms = MAX_VMS;
 
-        measurements = _get_measurements(num_vms);
-        double reward = _get_reward(action);
+        _get_measurements(num_vms);
+        double reward = _get_reward();
         return reward;
 
     }
 
-    double  _get_reward(pair<string,int> action){
-        int vms = measurements["number_of_VMs"];
-        double load = measurements["total_load"];
+    double  _get_reward(){
+        int vms = measurements[NUMBER_OF_VMS];
+        double load = measurements[TOTAL_LOAD];
         double capacity = get_current_capacity();
         double served_load = min(capacity, (double)load);
 
@@ -90,10 +141,10 @@ public:
     }
 
     double get_current_capacity(){
-        int vms = measurements["number_of_VMs"];
-        double read_load = measurements["%_read_load"];
-        double io_per_sec = measurements["io_per_sec"];
-        int ram_size = measurements["RAM_size"];
+        int vms = measurements[NUMBER_OF_VMS];
+        double read_load = measurements[READ_LOAD];
+        double io_per_sec = measurements[IO_PER_SEC];
+        int ram_size = measurements[RAM_SIZE];
         double io_penalty;
         double ram_penalty;
 
@@ -114,27 +165,23 @@ public:
         return capacity;
     }
 
-    json _get_measurements(int num_vms){
-
-        json measurements = {
-            {"number_of_VMs", num_vms},
-            {"RAM_size", this->_get_ram_size()},
-            {"number_of_CPUs", this->_get_num_cpus()},
-            {"storage_capacity", this->_get_storage_capacity()},
-            {"perc_free_RAM", this->_get_free_ram()},
-            {"perc_CPU_usage", this->_get_cpu_usage()},
-            {"io_per_sec", this->_get_io_per_sec()},
-            {"total_load", this->_get_load()},
-            {"%_read_load", this->_get_read_load()},
-            {"total_latency", this->_get_latency()}
-        };
+    void _get_measurements(int num_vms){
 
-        return measurements;
+        measurements[NUMBER_OF_VMS] = num_vms;
+        measurements[RAM_SIZE] = this->_get_ram_size();
+        measurements[NUMBER_OF_CPUS] = this->_get_num_cpus();
+        measurements[STORAGE_CAPACITY] = this->_get_storage_capacity();
+        measurements[PERC_FREE_RAM] = this->_get_free_ram();
+        measurements[PERC_CPU_USAGE] = this->_get_cpu_usage();
+        measurements[IO_PER_SEC] = this->_get_io_per_sec();
+        measurements[TOTAL_LOAD] = this->_get_load();
+        measurements[READ_LOAD] = this->_get_read_load();
+        measurements[TOTAL_LATENCY] = this->_get_latency();
 
         }
 
     double get_incoming_load(){
-        return measurements["total_load"];
+        return measurements[TOTAL_LOAD];
     }
 
     double _get_load(){
@@ -1,3 +1,5 @@
+#ifndef FINITEMDPMODEL_H
+#define FINITEMDPMODEL_H
 #include <iostream>
 #include <vector>
 #include <map>
@@ -11,6 +13,10 @@
 #include <sstream>
 
 #include "MDPModel.h"
+#include "ValueFunction.h"
+#include "CheckpointStore.h"
+#include "ActionStack.h"
+#include "RolloutStats.h"
 #include "Complex.h"
 
 #include "stdlib.h"
@@ -29,7 +35,24 @@
 #endif
 
 using namespace std::chrono;
-enum model_type {infinite, naive, root, tree, inplace,infiniteM};
+enum model_type {infinite, naive, root, tree, inplace,infiniteM, revolve};
+
+/*
+Reads the name of an algorithm, as given to the drivers: infinite, infinitem, naive, root, tree, inplace or revolve.
+Takes as input the name and the place for the algorithm.
+Returns false, leaving the algorithm unchanged, if the name is unknown.
+*/
+bool parse_algorithm(string name, model_type &algo){
+    if (name == "infinite") algo = infinite;
+    else if (name == "infinitem") algo = infiniteM;
+    else if (name == "naive") algo = naive;
+    else if (name == "root") algo = root;
+    else if (name == "tree") algo = tree;
+    else if (name == "inplace") algo = inplace;
+    else if (name == "revolve") algo = revolve;
+    else return false;
+    return true;
+}
 
 SIZE_T getValue(){
 #ifdef _WIN32
@@ -63,8 +86,9 @@ using namespace std;
 class FiniteMDPModel: public MDPModel{
     public:
         stack<int> index_stack;
-        stack<vector<pair<int , float>>> finite_stack;
-        stack<vector<int>> action_stack; //STACK TO CONTAIN VECTOR OF BEST QSTATE FOR EACH INDEX
+        CheckpointStore finite_stack; //value function checkpoints, in one preallocated slab
+        ValueFunction next_values; //second buffer of the finite evaluators, swapped with the current value function every step
+        ActionStack action_stack; //STACK TO CONTAIN VECTOR OF BEST QSTATE FOR EACH INDEX, in memory or spilled to disk
         float total_reward = 0.0;
         int max_memory_used = 0;
         int init_memory_used=0;
@@ -74,6 +98,13 @@ class FiniteMDPModel: public MDPModel{
         default_random_engine eng;
         uniform_real_distribution<float> unif;
         int stack_memory = 0;
+        vi_solver infinite_solver = jacobi; //solver of value_iteration for the infinite model
+        int checkpoint_budget = -1;       //checkpoints the revolve method may keep, -1 for log2(horizon)
+        long long recomputed_backups = 0; //horizon steps computed by the revolve method
+        int revolve_horizon = 0;
+        int revolve_budget = 0;
+        ostream* output = &cout;        //where runAlgorithm and runRollouts print their results
+        float execution_time = 0.0;     //seconds taken by the last runAlgorithm
 
     FiniteMDPModel(json conf = json({}), int seed = 21){
         if (conf.contains("discount"))
@@ -82,17 +113,18 @@ class FiniteMDPModel: public MDPModel{
         if (conf.contains("parameters"))
         parameters = _get_params(conf["parameters"]);
 
+        if (conf.contains("lazy_states"))
+        lazy_states = conf["lazy_states"];
+
         for (auto& element : parameters.items()) {
             index_params.push_back(element.key());
-            _update_states(element.key(), element.value());
+            state_index.add_parameter(element.key(), element.value()["values"]);
         }
 
+        num_potential_states = state_index.num_states;
+        if (!lazy_states)
+            _build_states();
 
-        int num_states = states.size();
-
-        for (auto & element : states){
-            element.set_num_states(num_states);
-        }
         if (conf.contains("actions")){
         _set_maxima_minima(parameters, conf["actions"]);
 
@@ -100,12 +132,54 @@ class FiniteMDPModel: public MDPModel{
             _add_qstates(conf["actions"], conf["initial_qvalues"]);
         }
         update_algorithm  = true;
+        _set_update_mode(conf);
         
         eng = default_random_engine(seed);
         unif = uniform_real_distribution<float>(0,1);
             
     };
 
+    /*
+    Selects how finite_stack encodes its checkpoints, see checkpoint_codec, and empties it.
+    The compressed codecs keep best QStates in a byte, models with more than 256 actions keep checkpoint_full.
+    Takes as input the codec and the error bound of checkpoint_quantized.
+    No output.
+    */
+    void set_checkpoint_codec(checkpoint_codec codec, float max_error = 0.01){
+        if (actions.size() > 256)
+            codec = checkpoint_full;
+        finite_stack.codec = codec;
+        finite_stack.max_error = max_error;
+        finite_stack.reserve(1, states.size());
+    }
+
+    /*
+    Saves the trained model to a snapshot file, with the state of the random engine, so that a model loaded
+    from it runs exactly as the one saved. See MDPModel::save_snapshot.
+    Returns false if the file cannot be written.
+    */
+    bool save_snapshot(string path){
+        ostringstream engine;
+        engine << eng;
+        return MDPModel::save_snapshot(path, engine.str());
+    }
+
+    /*
+    Replaces the model and the state of its random engine with the ones of a snapshot file.
+    Returns false, leaving the model unchanged, if the file cannot be loaded.
+    */
+    bool load_snapshot(string path){
+        string engine;
+        if (!MDPModel::load_snapshot(path, &engine))
+            return false;
+        if (!engine.empty()){
+            istringstream in(engine);
+            in >> eng;
+        }
+        next_values = ValueFunction();
+        return true;
+    }
+
     void setInitialState(State &s){
         current_state_num = s.state_num;
     }
@@ -136,43 +210,98 @@ class FiniteMDPModel: public MDPModel{
     }
 
 
-    void _q_update_finite(QState &qstate, vector<pair<int,float>> &V){
+    void _q_update_finite(QState &qstate, const ValueFunction &V){
         float new_qvalue = 0.0;
-        float r;
         float t;
-        for (int i=0; i < V.size(); i++){
-            t = qstate.get_transition(i);
-            r = qstate.get_reward(i);
-            new_qvalue += t * (r +V[i].second);
+        if (qstate.get_num_taken() == 0){ //never taken, every state is equally likely
+            t = qstate.get_transition(0);
+            for (int i=0; i < V.size(); i++)
+                new_qvalue += t * (0.0f + V.values[i]);
+            if (lazy_states)
+                new_qvalue += _unmaterialized_extra() * t * (0.0f + V.values[0]);
+        }
+        else{
+            TransitionStore &ts = *qstate.store;
+            int first = ts.begin(qstate.row);
+            new_qvalue = bellman_backup(&ts.successors[first], &ts.probabilities[first], &ts.mean_rewards[first], ts.size(qstate.row), V.values.data(), 1, 1.0f);
         }
         qstate.set_qvalue(new_qvalue);
     }
 
-    void _q_update_finite(QState &qstate, vector<pair<int,float>> &V, int time_step){
+    void _q_update_finite(QState &qstate, const ValueFunction &V, int time_step){
         float new_qvalue = 0.0;
-        float r;
         float t;
-        for (int i=0; i < V.size(); i++){
-            t = qstate.get_transition(i);
-            r = qstate.get_reward(i, time_step);
-            new_qvalue += t * (r +V[i].second);
+        if (qstate.get_num_taken() == 0){
+            t = qstate.get_transition(0);
+            for (int i=0; i < V.size(); i++)
+                new_qvalue += t * (0.0f + V.values[i]);
+            if (lazy_states)
+                new_qvalue += _unmaterialized_extra() * t * (0.0f + V.values[0]);
+        }
+        else{
+            TransitionStore &ts = *qstate.store;
+            int first = ts.begin(qstate.row);
+            new_qvalue = bellman_backup(&ts.successors[first], &ts.probabilities[first], &ts.mean_rewards[first], ts.size(qstate.row), V.values.data(), 1, 1.0f);
+            new_qvalue += qstate.reward_correction(time_step);
         }
         qstate.set_qvalue(new_qvalue);
     }
 
+    /*
+    Fills V with the value and best QState of every state, reusing the arrays of V.
+    No output.
+    */
+    void getValueFunction(ValueFunction &V){
+        V.resize(states.size());
+        for (int i=0; i < states.size(); i++){
+            V.values[i] = states[i].get_value();
+            V.best_qstates[i] = states[i].get_best_qstate();
+        }
+    }
 
-    vector<pair<int, float>> calculateValues(int k, int starting_index, vector<pair<int, float>> V, bool tree = false){
-        vector<pair<int,float>> V_tmp;
-        //V_tmp.reserve(states.size());      
-        V_tmp = V;
-        for (int i = starting_index+1 ; i < k+1; i++){
-            for (int j = 0 ; j < states.size(); j++ ){
-                for (int m = 0; m < states[j].get_qstates().size(); m++){
-                    _q_update_finite(states[j].qstates[m], V_tmp, i);
+    ValueFunction getValueFunction(){
+        ValueFunction V;
+        getValueFunction(V);
+        return V;
+    }
+
+    void loadValueFunction(const ValueFunction &V){
+        for (int i=0; i < V.size(); i++){
+            states[i].best_qstate = V.best_qstates[i];
+            states[i].value = V.values[i];
+        }
+    }
+
+    /*
+    One step of a finite-horizon evaluation: backs up every QState from V at the given time step and writes the
+    new value and best QState of every state into next_values, which is then swapped with V.
+    With unvisited_mean, the QStates of states never visited get the mean of V instead of a backup.
+    The states keep the values of the last step, so V does not need to be loaded back into them.
+    No output.
+    */
+    void _finite_step(ValueFunction &V, int time_step, bool unvisited_mean = false){
+        float num0rew = unvisited_mean ? calcrewa(V) : 0.0;
+        next_values.resize(states.size());
+        sweep_pool.run(states.size(), [&](int first, int last){
+            for (int j = first ; j < last; j++ ){
+                for (int n = 0; n < states[j].qstates.size(); n++){
+                    if (unvisited_mean && states[j].num_visited==0)
+                        states[j].qstates[n].set_qvalue(num0rew);
+                    else
+                        _q_update_finite(states[j].qstates[n], V, time_step); //FOR EVERY ACCESIBLE STATE FROM CURRENT QSTATE
                 }
                 states[j].update_value();
+                next_values.values[j] = states[j].value;
+                next_values.best_qstates[j] = states[j].best_qstate;
             }
-            V_tmp = getStateValues(states);
+        });
+        V.swap(next_values);
+    }
+
+    ValueFunction calculateValues(int k, int starting_index, const ValueFunction &V, bool tree = false){
+        ValueFunction V_tmp = V;
+        for (int i = starting_index+1 ; i < k+1; i++){
+            _finite_step(V_tmp, i);
             if (!tree){
                 index_stack.push(i);
                 finite_stack.push(V_tmp);
@@ -186,17 +315,10 @@ class FiniteMDPModel: public MDPModel{
         return V_tmp;
 
     }
-    void calculateValuestest(int k, int starting_index, vector<pair<int, float>> &V, bool tree = false){
+    void calculateValuestest(int k, int starting_index, ValueFunction &V, bool tree = false){
 
         for (int i = starting_index+1 ; i < k+1; i++){
-            for (int j = 0 ; j < states.size(); j++ ){
-                
-                for (int m = 0; m < states[j].get_qstates().size(); m++){
-                    _q_update_finite(states[j].qstates[m], V, i);
-                }
-                states[j].update_value();
-            }
-            V = getStateValuestest(states);
+            _finite_step(V, i);
             if (!tree){
                 index_stack.push(i);
                 finite_stack.push(V);
@@ -209,32 +331,9 @@ class FiniteMDPModel: public MDPModel{
 
     }
 
-        void calculateValuestestcorrR(int k, int starting_index, vector<pair<int, float>> &V, bool tree = false){
-            float num0rew=-1;
-            int statenum=-1;
+        void calculateValuestestcorrR(int k, int starting_index, ValueFunction &V, bool tree = false){
             for (int i = starting_index+1 ; i < k+1; i++){
-                num0rew=calcrewa(V);
-            for (int j = 0 ; j < states.size(); j++ ){
-                
-            for (int n = 0; n < states[j].get_qstates().size(); n++){
-                    float new_qvalue = 0.0;
-                    float r;
-                    float t;
-                    if (states[j].num_visited==0)
-                        states[j].qstates[n].set_qvalue(num0rew);
-                    else{
-                    for (int m=0; m < states[j].qstates[n].trans.size(); m++){ //FOR EVERY ACCESIBLE STATE FROM CURRENT QSTATE
-                        t = states[j].qstates[n].trans[m];
-                        statenum=states[j].qstates[n].transtate[m];
-                        r = states[j].qstates[n].get_reward(statenum, i);
-                        new_qvalue += t * (r +V[statenum].second);
-                    }
-                    states[j].qstates[n].set_qvalue(new_qvalue);
-                }
-                }
-                states[j].update_value();
-            }
-            V = getStateValuestest(states);
+            _finite_step(V, i, true);
             if (!tree){
                 //index_stack.push(i);
                 finite_stack.push(V);
@@ -246,32 +345,9 @@ class FiniteMDPModel: public MDPModel{
         checkMemoryUsage();
 
     }
-    void calculateValuestestcorr(int k, int starting_index, vector<pair<int, float>> &V, bool tree = false){
-            float num0rew=-1;
-            int statenum=-1;
+    void calculateValuestestcorr(int k, int starting_index, ValueFunction &V, bool tree = false){
             for (int i = starting_index+1 ; i < k+1; i++){
-                num0rew=calcrewa(V);
-            for (int j = 0 ; j < states.size(); j++ ){
-                
-            for (int n = 0; n < states[j].get_qstates().size(); n++){
-                    float new_qvalue = 0.0;
-                    float r;
-                    float t;
-                    if (states[j].num_visited==0)
-                        states[j].qstates[n].set_qvalue(num0rew);
-                    else{
-                    for (int m=0; m < states[j].qstates[n].trans.size(); m++){ //FOR EVERY ACCESIBLE STATE FROM CURRENT QSTATE
-                        t = states[j].qstates[n].trans[m];
-                        statenum=states[j].qstates[n].transtate[m];
-                        r = states[j].qstates[n].get_reward(statenum, i);
-                        new_qvalue += t * (r +V[statenum].second);
-                    }
-                    states[j].qstates[n].set_qvalue(new_qvalue);
-                }
-                }
-                states[j].update_value();
-            }
-            V = getStateValuestest(states);
+            _finite_step(V, i, true);
             if (!tree){
                 index_stack.push(i);
                 finite_stack.push(V);
@@ -284,12 +360,12 @@ class FiniteMDPModel: public MDPModel{
 
     }
 
-       pair<std::string,int> finite_suggest_action(){
+       int finite_suggest_action(){
         return states[current_state_num].get_optimal_action();
     }
 
     void takeAction(bool isInfinite, int time_step, bool p=false){
-        pair<std::string,int> action;
+        int action;
         if (isInfinite) {action = suggest_action();}
         else {action = finite_suggest_action();}
         float reward;
@@ -299,18 +375,16 @@ class FiniteMDPModel: public MDPModel{
         int prev_state_num = current_state_num;
         //current_state_num = _get_state(meas)->get_state_num();
         float x = unif(eng);
-        float acc = 0.0;
+        //matched by action id: matching by type (action.first) as before would also sample the QStates of the other
+        //values of the type (add_VMs 1 and add_VMs 2), the last one overriding the chosen action; the shipped
+        //configurations have one value per type, where both give the same states and rewards
         for (int i=0; i< states[prev_state_num].qstates.size();i++){
-            if (states[prev_state_num].qstates[i].action.first == action.first){
-                for (int j=0; j<states[prev_state_num].qstates[i].transitions.size();j++){
-                    if (states[prev_state_num].qstates[i].get_transition(j) > 0){
-                        acc += states[prev_state_num].qstates[i].get_transition(j);
-                        if (x < acc){
-                            current_state_num = j;
-                            reward = states[prev_state_num].qstates[i].get_reward(current_state_num, time_step);
-                            break;
-                        }
-                    }
+            if (states[prev_state_num].qstates[i].action == action){
+                QState &qs = states[prev_state_num].qstates[i];
+                int next = _sample_next(qs, x);
+                if (next >= 0){
+                    current_state_num = next;
+                    reward = qs.get_reward(current_state_num, time_step);
                 }
             }
         }
@@ -319,25 +393,51 @@ class FiniteMDPModel: public MDPModel{
         if (p){
             cout << "Current state: " << prev_state_num<< endl;
             for (int i=0; i < states[prev_state_num].qstates.size(); i++){
-                cout << "   Qstate: " << states[prev_state_num].qstates[i].action.first << " ,QValue:" << states[prev_state_num].qstates[i].qvalue << endl;
+                cout << "   Qstate: " << actions[states[prev_state_num].qstates[i].action].first << " ,QValue:" << states[prev_state_num].qstates[i].qvalue << endl;
             }
-            cout << action.first << " ,Reward: " << reward << "   Next state: " << endl << states[current_state_num] << endl;
+            cout << actions[action].first << " ,Reward: " << reward << "   Next state: " << endl << states[current_state_num] << endl;
+        }
+    }
+
+    /*
+    Samples the state reached by taking a QState: binary search on the cumulative distributions of the store
+    when build_cumulative() has been called since the last transition was recorded, a linear walk otherwise.
+    Both pick the same state for the same x.
+    Takes as input the QState and a uniform number x in [0, 1).
+    Returns the next state, or -1 if rounding left x above the total probability.
+    */
+    int _sample_next(QState &qs, float x){
+        TransitionStore &ts = *qs.store;
+        bool uniform = (qs.get_num_taken() == 0); //never taken, every state is equally likely
+        if (uniform && lazy_states) //every state of the grid, slot 0 for the ones not materialized
+            return _slot(min(num_potential_states - 1, (int)(x * num_potential_states)));
+        if (ts.has_cumulative() && ts.uniform_cumulative.size() == states.size()){
+            if (uniform) return ts.sample_uniform(x);
+            int pos = ts.sample(qs.row, x);
+            return (pos < 0) ? -1 : ts.successors[pos];
         }
+        float acc = 0.0;
+        int first = uniform ? 0 : ts.begin(qs.row);
+        int last = uniform ? states.size() : ts.end(qs.row);
+        for (int k=first; k<last;k++){
+            int j = uniform ? k : ts.successors[k];
+            acc += uniform ? qs.get_transition(j) : ts.probabilities[k];
+            if (x < acc)
+                return j;
+        }
+        return -1;
     }
 
     void takeAction2(int corraction, int time_step){
         float reward;
         int prev_state_num = current_state_num;
         float x = unif(eng);
-        float acc = 0.0;
-            for (int j=0; j<states[prev_state_num].qstates[corraction].trans.size();j++){
-                    acc += states[prev_state_num].qstates[corraction].trans[j];
-                    if (x < acc){
-                        current_state_num = states[prev_state_num].qstates[corraction].transtate[j];
-                        reward = states[prev_state_num].qstates[corraction].get_reward(current_state_num, time_step);
-                        break;
-                    }
-                }
+        QState &qs = states[prev_state_num].qstates[corraction];
+        int next = _sample_next(qs, x);
+        if (next >= 0){
+            current_state_num = next;
+            reward = qs.get_reward(current_state_num, time_step);
+        }
         total_reward += reward;
     }
 
@@ -349,24 +449,25 @@ class FiniteMDPModel: public MDPModel{
             steps_made++;
 
             //vector<State> V;
-            vector<pair<int,float>> V;
+            ValueFunction V;
             if (finite_stack.empty()){
                 resetValueFunction();
                 //V = calculateValues(k, 0, states, true); //if no vector is saved in memory, calculate objective from the beginning
-                V = calculateValues(k, 0, getStateValues(states), true);
+                V = calculateValues(k, 0, getValueFunction(), true);
 
             }
             else{
 
-                V = calculateValues(k, index_stack.top(), finite_stack.top(), true);//use last saved vector in memory to calculate objective
+                finite_stack.top(V);
+                V = calculateValues(k, index_stack.top(), V, true);//use last saved vector in memory to calculate objective
             }
 
             finite_stack.push(V);//add newly calculated vector to memory
             index_stack.push(k);
 
-            stack_memory += V.size() * sizeof(pair<int,float>);
+            stack_memory += V.memory_used();
 
-            if (V[initial_state_num].second > expected_reward) expected_reward = V[initial_state_num].second;
+            if (V.values[initial_state_num] > expected_reward) expected_reward = V.values[initial_state_num];
 
             traverseTree(k+1, r);
 
@@ -377,7 +478,7 @@ class FiniteMDPModel: public MDPModel{
             finite_stack.pop();//remove top of the stack from memory
             index_stack.pop();
 
-            stack_memory -= V.size() * sizeof(pair<int,float>);
+            stack_memory -= V.memory_used();
 
             traverseTree(l, k-1);
         }
@@ -386,18 +487,19 @@ class FiniteMDPModel: public MDPModel{
     void naiveEvaluation(int horizon){
             //vector<State> V;
 
-            vector<pair<int,float>> V;
+            ValueFunction V;
             //V.reserve(states.size());
             resetValueFunction();
             //V = calculateValues(horizon, 0, states);
-            V = calculateValues(horizon, 0, getStateValues(states));
-            expected_reward = V[initial_state_num].second;
+            V = calculateValues(horizon, 0, getValueFunction());
+            expected_reward = V.values[initial_state_num];
             while (!finite_stack.empty()){
 
                 steps_made++;
 
                 //states = finite_stack.top();
-                loadValueFunction(finite_stack.top());
+                finite_stack.top(V);
+                loadValueFunction(V);
                 //takeAction(false);
                 finite_stack.pop();
                 index_stack.pop();
@@ -446,19 +548,11 @@ class FiniteMDPModel: public MDPModel{
         vector<float> V_tmp;
         //V_tmp.reserve(states.size());      
         V_tmp = getStateValueFunction();
+        action_stack.reserve(k, states.size());
         for (int i = 1 ; i < k+1; i++){ //FOR EVERY INDEX UP TO THE HORIZON
             for (int j = 0 ; j < states.size(); j++ ){ //FOR EVERY STATE
-                for (int n = 0; n < states[j].get_qstates().size(); n++){ //FOR EVERY QSTATE OF EACH STATE
-                    float new_qvalue = 0.0;
-                    float r;
-                    float t;
-                    for (int m=0; m < V_tmp.size(); m++){ //FOR EVERY ACCESIBLE STATE FROM CURRENT QSTATE
-                        t = states[j].qstates[n].get_transition(m);
-                        r = states[j].qstates[n].get_reward(m, i);
-                        new_qvalue += t * (r +V_tmp[m]);
-                    }
-
-                    states[j].qstates[n].set_qvalue(new_qvalue);
+                for (int n = 0; n < states[j].qstates.size(); n++){ //FOR EVERY QSTATE OF EACH STATE
+                    _q_update2(states[j].qstates[n], V_tmp, i);
                 }
                 states[j].update_value();
             }
@@ -476,51 +570,32 @@ class FiniteMDPModel: public MDPModel{
         for (int m=0; m < V_tmp.size(); m++){ //FOR EVERY ACCESIBLE STATE FROM CURRENT QSTATE
                         new_qvalue += (V_tmp[m]);
                     }
+        if (lazy_states)
+            return (new_qvalue + _unmaterialized_extra() * V_tmp[0]) / num_potential_states;
         return new_qvalue/states.size();
     }
-    float calcrewa(vector<pair<int,float>> V_tmp){
+    float calcrewa(const ValueFunction &V_tmp){
         float new_qvalue=0;
         for (int m=0; m < V_tmp.size(); m++){ //FOR EVERY ACCESIBLE STATE FROM CURRENT QSTATE
-                        new_qvalue += (V_tmp[m].second);
+                        new_qvalue += (V_tmp.values[m]);
                     }
+        if (lazy_states)
+            return (new_qvalue + _unmaterialized_extra() * V_tmp.values[0]) / num_potential_states;
         return new_qvalue/states.size();
     }
     float calculatePolicycorr(int k){
-        vector<float> V_tmp;
-        //V_tmp.reserve(states.size());      
-        V_tmp = getStateValueFunction();
-        int statenum;
-        float num0rew=0;
+        ValueFunction V_tmp;
+        getValueFunction(V_tmp);
+        action_stack.reserve(k, states.size());
         for (int i = 1 ; i < k+1; i++){ //FOR EVERY INDEX UP TO THE HORIZON
-                 num0rew=calcrewa(V_tmp);  
-            for (int j = 0 ; j < states.size(); j++ ){ //FOR EVERY STATE   
-                     
-                for (int n = 0; n < states[j].get_qstates().size(); n++){ //FOR EVERY QSTATE OF EACH STATE
-                    float new_qvalue = 0.0;
-                    float r;
-                    float t;
-                    if (states[j].num_visited==0)
-                        states[j].qstates[n].set_qvalue(num0rew);
-                    else{
-                    for (int m=0; m < states[j].qstates[n].trans.size(); m++){ //FOR EVERY ACCESIBLE STATE FROM CURRENT QSTATE
-                        t = states[j].qstates[n].trans[m];
-                        statenum=states[j].qstates[n].transtate[m];
-                        r = states[j].qstates[n].get_reward(statenum, i);
-                        new_qvalue += t * (r +V_tmp[statenum]);
-                    }
-                    states[j].qstates[n].set_qvalue(new_qvalue);
-                }
-                }
-                states[j].update_value();
-            }
-            V_tmp = getStateValueFunction();
+            _finite_step(V_tmp, i, true);
 
-            action_stack.push(getStateActions());
+            action_stack.push(V_tmp.best_qstates);
             stack_memory++;
             checkStackSize();
             checkMemoryUsage();
         }
-        return V_tmp[initial_state_num];
+        return V_tmp.values[initial_state_num];
     }
     /*
     Runs the Naive Finite-Horizon MDP method using calculatePolicy.
@@ -532,11 +607,13 @@ class FiniteMDPModel: public MDPModel{
         expected_reward = calculatePolicy(horizon);
         auto end22 = std::chrono::high_resolution_clock::now();     // the new current "timepoint"
         auto elapsed = end22 - start22;                 // difference is a "duration"
-        std::cout << "hoho" << ": " << elapsed.count()* 0.000001 << '\n';  // clock ticks (seconds)
+        *output << "hoho" << ": " << elapsed.count()* 0.000001 << '\n';  // clock ticks (seconds)
     
+        vector<int> layer;
         while (!action_stack.empty()){
             steps_made++;
-            loadBestQStates(action_stack.top());
+            action_stack.top(layer);
+            loadBestQStates(layer);
             //takeAction(false);
             action_stack.pop();
             stack_memory--;
@@ -548,14 +625,12 @@ class FiniteMDPModel: public MDPModel{
         expected_reward = calculatePolicycorr(horizon);
         auto end22 = std::chrono::high_resolution_clock::now();     // the new current "timepoint"
         auto elapsed = end22 - start22;                 // difference is a "duration"
-        std::cout << "hoho" << ": " << elapsed.count()* 0.000001 << '\n';  // clock ticks (seconds)
+        *output << "hoho" << ": " << elapsed.count()* 0.000001 << '\n';  // clock ticks (seconds)
     
         int actiont=-1;
-        vector<int> V;
         steps_made = 0;
         while (!action_stack.empty()){
-            V=action_stack.top();
-            actiont=V[current_state_num];
+            actiont=action_stack.top(current_state_num);
             takeAction2(actiont, horizon - steps_made);
             action_stack.pop();
             steps_made++;
@@ -567,14 +642,11 @@ class FiniteMDPModel: public MDPModel{
 
     void inPlaceEvaluation(int horizon){
 
-        vector<pair<int,float>> V;
-        vector<pair<int,float>> Ve;
+        ValueFunction V;
         int steps_remaining = horizon;
         resetValueFunction();
-        vector<pair<int,float>> values;
-        //values.reserve(states.size());
-        V = calculateValues(steps_remaining, 0, getStateValues(states),true);
-        expected_reward = V[initial_state_num].second;
+        V = calculateValues(steps_remaining, 0, getValueFunction(),true);
+        expected_reward = V.values[initial_state_num];
         loadValueFunction(V);
         //takeAction(false);
         steps_made++;
@@ -582,7 +654,7 @@ class FiniteMDPModel: public MDPModel{
         checkMemoryUsage();
         int a=getValue();
         while(steps_remaining > 0){
-            V = calculateValues(steps_remaining, 0, getStateValues(states),true);
+            V = calculateValues(steps_remaining, 0, getValueFunction(),true);
             a=getValue();
             loadValueFunction(V);
             //takeAction(false);
@@ -591,17 +663,16 @@ class FiniteMDPModel: public MDPModel{
         }
     }
        void inPlaceEvaluation3(int horizon){
-        vector<pair<int,float>> V;
+        ValueFunction V;
         //V_temp.reserve(states.size()); 
         //V.reserve(states.size()); 
         int steps_remaining = horizon;
         resetValueFunction();
-        V =getStateValuestest(states);
+        getValueFunction(V);
         calculateValuestestcorrR(steps_remaining, 0, V,true);
-        expected_reward = V[initial_state_num].second;
-        loadValueFunctiontest(V);
+        expected_reward = V.values[initial_state_num];
         //takeAction(false, horizon);
-        takeAction2(V[current_state_num].first, steps_remaining);
+        takeAction2(V.best_qstates[current_state_num], steps_remaining);
         steps_made++;
         steps_remaining--;
         if (getValue() > max_memory_used){
@@ -609,11 +680,10 @@ class FiniteMDPModel: public MDPModel{
         }
         while(steps_remaining > 0){
             resetValueFunction();
-            V=getStateValuestest(states);
+            getValueFunction(V);
             calculateValuestestcorrR(steps_remaining, 0, V,true);
-            loadValueFunctiontest(V);
             //takeAction(false, steps_remaining);
-            takeAction2(V[current_state_num].first, steps_remaining);
+            takeAction2(V.best_qstates[current_state_num], steps_remaining);
             steps_made++;
             steps_remaining--;
         }
@@ -621,37 +691,20 @@ class FiniteMDPModel: public MDPModel{
 
     void inPlaceEvaluation2(int horizon){
 
-        vector<pair<int,float>> V;
-        vector<pair<int,float>> Ve;
+        ValueFunction V;
         int steps_remaining = horizon;
         resetValueFunction();
-        vector<pair<int,float>> values;
-        //values.reserve(states.size());
-        vector<pair<int,float>> V_tmp;
-        V=getStateValues1(states,values);
+        getValueFunction(V);
         //calculateValues now
-        V;
         int a;
         for (int i = 1 ; i < steps_remaining+1; i++){
-            for (int j = 0 ; j < states.size(); j++ ){
-                for (int m = 0; m < states[j].get_qstates().size(); m++){
-                    _q_update_finite(states[j].qstates[m], V, i);
-                }
-                states[j].update_value();
-            }
-            a=getValue();
-            //V_tmp.clear();
-            for (int i=0; i < V.size(); i++)
-                values.push_back(make_pair( states[i].get_best_qstate(), states[i].get_value()));
-            V=values;
-            values.clear();
+            _finite_step(V, i);
             a=getValue();
             }
 
         checkMemoryUsage();
         //calculateValues finished
-        expected_reward = V[initial_state_num].second;
-        loadValueFunction(V);
+        expected_reward = V.values[initial_state_num];
         //takeAction(false);
         steps_made++;
         steps_remaining--;
@@ -660,24 +713,10 @@ class FiniteMDPModel: public MDPModel{
         while(steps_remaining > 0){
 
             for (int i = 1 ; i < steps_remaining+1; i++){
-            for (int j = 0 ; j < states.size(); j++ ){
-                for (int m = 0; m < states[j].get_qstates().size(); m++){
-                    _q_update_finite(states[j].qstates[m], V, i);
-                }
-                states[j].update_value();
+                _finite_step(V, i);
             }
             a=getValue();
-            //V_tmp.clear();
-            //V = getStateValues(states);
-            //getStateValues
-            for (int i=0; i < V.size(); i++)
-                values.push_back(make_pair( states[i].get_best_qstate(), states[i].get_value()));
-            V=values;
-            values.clear();
-        }
-            a=getValue();
             
-            loadValueFunction(V);
             //takeAction(false);
             steps_made++;
             steps_remaining--;
@@ -688,24 +727,26 @@ class FiniteMDPModel: public MDPModel{
 
 void rootEvaluation2(int horizon){
 
-        vector<pair<int,float>> V;
+        ValueFunction V;
         //V.reserve(states.size());
         //V.reserve(states.size());
         int steps_remaining = horizon;
         //resetValueFunction();
         int floor_of_square_root = floor(sqrt(horizon));
+        //one checkpoint every floor_of_square_root steps, plus the steps of the segment being replayed
+        finite_stack.reserve(horizon / floor_of_square_root + floor_of_square_root, states.size());
         int i=0;
-        V=getStateValuestest(states);
+        getValueFunction(V);
         for ( ;i+floor_of_square_root <= horizon; i=i+floor_of_square_root){
             calculateValuestest(i+floor_of_square_root,i,  V, true);
             finite_stack.push(V);
             //stack_memory++;
         }
         if (i!=horizon){
-            V=getStateValuestest(states);
+            getValueFunction(V);
             calculateValuestest(horizon, i, V);
         }
-        expected_reward = V[initial_state_num].second;
+        expected_reward = V.values[initial_state_num];
         //checkStackSize();
         checkMemoryUsage();
         for ( ;i < horizon; i=i+1){ 
@@ -716,23 +757,23 @@ void rootEvaluation2(int horizon){
             //stack_memory--;
             //steps_made++;
             steps_remaining--;
-            V = finite_stack.top();  
+            finite_stack.top(V);
         }
         while(steps_remaining > 0){
             if (finite_stack.empty()){
                 resetValueFunction();
-                V=getStateValuestest(states);
+                getValueFunction(V);
                 calculateValuestest(steps_remaining, 0, V);
             }
             else{
 
                 if( (steps_remaining+1)%floor_of_square_root==0){
-                    V=finite_stack.top();
+                    finite_stack.top(V);
                     calculateValuestest(steps_remaining, steps_remaining-floor_of_square_root+1,V );
                     //checkMemoryUsage();
                 }
                 else
-                    V = finite_stack.top();            
+                    finite_stack.top(V);
             }
             loadValueFunction(V);
             //takeAction(false);
@@ -743,60 +784,63 @@ void rootEvaluation2(int horizon){
             //steps_made++;
             steps_remaining--;
         }
+        max_stack_memory = finite_stack.peak_memory();
     }
 
 void rootEvaluationcorr(int horizon){
 
-        vector<pair<int,float>> V;
+        ValueFunction V;
         //V.reserve(states.size());
         //V.reserve(states.size());
         int steps_remaining = horizon;
         int actiont=-1;
         resetValueFunction();
         int floor_of_square_root = floor(sqrt(horizon));
+        //one checkpoint every floor_of_square_root steps, plus the steps of the segment being replayed
+        finite_stack.reserve(horizon / floor_of_square_root + floor_of_square_root, states.size());
         int i=0;
-        V=getStateValuestest(states);
+        getValueFunction(V);
         for ( ;i+floor_of_square_root <= horizon; i=i+floor_of_square_root){
             calculateValuestestcorrR(i+floor_of_square_root,i,  V, true);
             finite_stack.push(V);
             //stack_memory++;
         }
         if (i!=horizon){
-            V=getStateValuestest(states);
+            getValueFunction(V);
             calculateValuestestcorrR(horizon, i, V);
         }
-        expected_reward = V[initial_state_num].second;
+        expected_reward = V.values[initial_state_num];
         //checkStackSize();
         checkMemoryUsage();
         for ( ;i < horizon; i=i+1){ 
            
             loadValueFunction(V);
-            takeAction2(V[current_state_num].first, steps_remaining);
+            takeAction2(V.best_qstates[current_state_num], steps_remaining);
             //takeAction(false, horizon-i);
             finite_stack.pop();
             //stack_memory--;
             //steps_made++;
             steps_remaining--;
-            V = finite_stack.top();  
+            finite_stack.top(V);
         }
         while(steps_remaining > 0){
             if (finite_stack.empty()){
                 resetValueFunction();
-                V=getStateValuestest(states);
+                getValueFunction(V);
                 calculateValuestestcorrR(steps_remaining, 0, V);
             }
             else{
 
                 if( (steps_remaining+1)%floor_of_square_root==0){
-                    V=finite_stack.top();
+                    finite_stack.top(V);
                     calculateValuestestcorrR(steps_remaining, steps_remaining-floor_of_square_root+1,V );
                     //checkMemoryUsage();
                 }
                 else
-                    V = finite_stack.top();            
+                    finite_stack.top(V);
             }
-            loadValueFunctiontest(V);
-            takeAction2(V[current_state_num].first, steps_remaining);
+            loadValueFunction(V);
+            takeAction2(V.best_qstates[current_state_num], steps_remaining);
             //checkStackSize();
             checkMemoryUsage();
             finite_stack.pop();
@@ -804,16 +848,17 @@ void rootEvaluationcorr(int horizon){
             //steps_made++;
             steps_remaining--;
         }
+        max_stack_memory = finite_stack.peak_memory();
     }
 
     void rootEvaluation(int horizon){
 
-        vector<pair<int,float>> V;
+        ValueFunction V;
         //V.reserve(states.size());
         int steps_remaining = horizon;
         resetValueFunction();
 
-        V = calculateValues(1, 0, getStateValues(states),true);
+        V = calculateValues(1, 0, getValueFunction(),true);
         int floor_of_square_root = floor(sqrt(horizon));
 
         for (int i = 2; i <= horizon; i++){
@@ -825,20 +870,21 @@ void rootEvaluationcorr(int horizon){
                 checkStackSize();
             }
         }
-        expected_reward = V[initial_state_num].second;
+        expected_reward = V.values[initial_state_num];
 
         while(steps_remaining > 0){
             if (finite_stack.empty()){
                 resetValueFunction();
-                V = calculateValues(steps_remaining, 0, getStateValues(states));
+                V = calculateValues(steps_remaining, 0, getValueFunction());
 
             }
             else{
                 if(index_stack.top() == steps_remaining){
-                    V = finite_stack.top();
+                    finite_stack.top(V);
                 }
                 else{
-                    V = calculateValues(steps_remaining, index_stack.top(), finite_stack.top());
+                    finite_stack.top(V);
+                    V = calculateValues(steps_remaining, index_stack.top(), V);
                     
                 }
             }
@@ -862,8 +908,8 @@ void rootEvaluationcorr(int horizon){
 
     void printValueFunction(){
         if(!finite_stack.empty()){
-            for (int i = 0; i < finite_stack.top().size(); i++){
-                cout << "State " << i << ": " << finite_stack.top()[i].second << endl;
+            for (int i = 0; i < finite_stack.num_states; i++){
+                cout << "State " << i << ": " << finite_stack.top_value(i) << endl;
             }
         }
         else{
@@ -891,11 +937,12 @@ void rootEvaluationcorr(int horizon){
         max_memory_used = 0.0;
         steps_made = 0;
         stack_memory = 0;
+        index_stack = stack<int>(); //the checkpoints it indexes are dropped by the next finite_stack.reserve()
     }
 
 
     //calculates Value Function for target index while saving every intermediate index needed
-    void treeTraversal1(int target, int horizon, vector<pair<int,float>> &V){
+    void treeTraversal1(int target, int horizon, ValueFunction &V){
         int l = 0;
         int r = horizon;
 
@@ -904,7 +951,7 @@ void rootEvaluationcorr(int horizon){
         int k = (l + r)/2;
         if (!index_stack.empty()){
             if (index_stack.top() == target){
-                V = finite_stack.top();
+                finite_stack.top(V);
                 finite_stack.pop();
                 index_stack.pop();
                 //stack_memory--;
@@ -920,12 +967,12 @@ void rootEvaluationcorr(int horizon){
             if (k == target){
                 if (finite_stack.empty()){
                     resetValueFunction();//if no vector is saved in memory, calculate objective from the beginning
-                    V=getStateValuestest(states);
+                    getValueFunction(V);
                     calculateValuestestcorrR(k, 0, V, true);
 
                 }
                 else{
-                    V=finite_stack.top();
+                    finite_stack.top(V);
                     calculateValuestestcorrR(k, index_stack.top(),V , true);//use last saved vector in memory to calculate objective
                     
                 }
@@ -934,7 +981,7 @@ void rootEvaluationcorr(int horizon){
             else if ( k < target){
                 if (finite_stack.empty()){
                     resetValueFunction();//if no vector is saved in memory, calculate objective from the beginning
-                    V=getStateValuestest(states);
+                    getValueFunction(V);
                     calculateValuestestcorrR(k, 0, V, true);
                     finite_stack.push(V);
                     index_stack.push(k);
@@ -943,7 +990,7 @@ void rootEvaluationcorr(int horizon){
                 }
                 else{
                     if (index_stack.top() != k){
-                        V=finite_stack.top();
+                        finite_stack.top(V);
                         calculateValuestestcorrR(k, index_stack.top(), V, true);
                         finite_stack.push(V);//use last saved vector in memory to calculate objective
                         index_stack.push(k);
@@ -962,7 +1009,7 @@ void rootEvaluationcorr(int horizon){
         checkMemoryUsage();
         
     }
-    void treeTraversalcorr(int target, int horizon, vector<pair<int,float>> &V){
+    void treeTraversalcorr(int target, int horizon, ValueFunction &V){
         int l = 0;
         int r = horizon;
 
@@ -971,7 +1018,7 @@ void rootEvaluationcorr(int horizon){
         int k = (l + r)/2;
         if (!index_stack.empty()){
             if (index_stack.top() == target){
-                V = finite_stack.top();
+                finite_stack.top(V);
                 finite_stack.pop();
                 index_stack.pop();
                 //stack_memory--;
@@ -987,12 +1034,12 @@ void rootEvaluationcorr(int horizon){
             if (k == target){
                 if (finite_stack.empty()){
                     resetValueFunction();//if no vector is saved in memory, calculate objective from the beginning
-                    V=getStateValuestest(states);
+                    getValueFunction(V);
                     calculateValuestestcorr(k, 0, V, true);
 
                 }
                 else{
-                    V=finite_stack.top();
+                    finite_stack.top(V);
                     calculateValuestestcorr(k, index_stack.top(),V , true);//use last saved vector in memory to calculate objective
                     
                 }
@@ -1001,7 +1048,7 @@ void rootEvaluationcorr(int horizon){
             else if ( k < target){
                 if (finite_stack.empty()){
                     resetValueFunction();//if no vector is saved in memory, calculate objective from the beginning
-                    V=getStateValuestest(states);
+                    getValueFunction(V);
                     calculateValuestestcorr(k, 0, V, true);
                     finite_stack.push(V);
                     index_stack.push(k);
@@ -1010,7 +1057,7 @@ void rootEvaluationcorr(int horizon){
                 }
                 else{
                     if (index_stack.top() != k){
-                        V=finite_stack.top();
+                        finite_stack.top(V);
                         calculateValuestestcorr(k, index_stack.top(), V, true);
                         finite_stack.push(V);//use last saved vector in memory to calculate objective
                         index_stack.push(k);
@@ -1032,12 +1079,12 @@ void rootEvaluationcorr(int horizon){
 
     void treeEvaluation(int horizon){
         int steps_remaining = horizon;
-        vector<pair<int,float>> V;
+        ValueFunction V;
         //V.reserve(states.size());
         while(steps_remaining > 0){
             V = treeTraversal(steps_remaining, horizon);
             if (steps_remaining == horizon)
-                expected_reward = V[initial_state_num].second;
+                expected_reward = V.values[initial_state_num];
             loadValueFunction(V);
             //takeAction(false);
             steps_remaining--;
@@ -1045,46 +1092,52 @@ void rootEvaluationcorr(int horizon){
     }
         void treeEvaluation2(int horizon){
         int steps_remaining = horizon;
-        vector<pair<int,float>> V;
+        ValueFunction V;
         //V.reserve(states.size());
+        //treeTraversal keeps one checkpoint per level of the binary search over [0, horizon]
+        finite_stack.reserve(floor(log2(horizon + 1)), states.size());
         while(steps_remaining > 0){
             treeTraversal1(steps_remaining, horizon,V);
             if (steps_remaining == horizon)
-                expected_reward = V[initial_state_num].second;
-            loadValueFunctiontest(V);
+                expected_reward = V.values[initial_state_num];
+            loadValueFunction(V);
             takeAction(false, steps_remaining);
             checkMemoryUsage();
             steps_remaining--;
         }
+        max_stack_memory = finite_stack.peak_memory();
     }
  void treeEvaluationcorr(int horizon){
         int steps_remaining = horizon;
         int actiont=-1;
-        vector<pair<int,float>> V;
+        ValueFunction V;
         //V.reserve(states.size());
+        //treeTraversal keeps one checkpoint per level of the binary search over [0, horizon]
+        finite_stack.reserve(floor(log2(horizon + 1)), states.size());
         while(steps_remaining > 0){
             treeTraversalcorr(steps_remaining, horizon,V);
             if (steps_remaining == horizon)
-                expected_reward = V[initial_state_num].second;
-            loadValueFunctiontest(V);
-            takeAction2(V[current_state_num].first, steps_remaining);
+                expected_reward = V.values[initial_state_num];
+            loadValueFunction(V);
+            takeAction2(V.best_qstates[current_state_num], steps_remaining);
             checkMemoryUsage();
             steps_remaining--;
         }
+        max_stack_memory = finite_stack.peak_memory();
     }
 
-    vector<pair<int,float>> treeTraversal(int target, int horizon){
+    ValueFunction treeTraversal(int target, int horizon){
         int l = 0;
         int r = horizon;
-        vector<pair<int,float>> V;
+        ValueFunction V;
         //V.reserve(states.size());
         int k = (l + r)/2;
         if (!index_stack.empty()){
             if (index_stack.top() == target){
-                V = finite_stack.top();
+                finite_stack.top(V);
+                stack_memory -= finite_stack.slot_bytes();
                 finite_stack.pop();
                 index_stack.pop();
-                stack_memory -= states.size()*sizeof(pair<int,float>);
                 return V;
             }
             else{
@@ -1095,10 +1148,11 @@ void rootEvaluationcorr(int horizon){
             if (k == target){
                 if (finite_stack.empty()){
                     resetValueFunction();//if no vector is saved in memory, calculate objective from the beginning
-                    V = calculateValues(k, 0, getStateValues(states), true);
+                    V = calculateValues(k, 0, getValueFunction(), true);
                 }
                 else{
-                    V = calculateValues(k, index_stack.top(), finite_stack.top(), true);//use last saved vector in memory to calculate objective
+                    finite_stack.top(V);
+                    V = calculateValues(k, index_stack.top(), V, true);//use last saved vector in memory to calculate objective
                     
                 }
                 break;
@@ -1106,17 +1160,18 @@ void rootEvaluationcorr(int horizon){
             else if ( k < target){
                 if (finite_stack.empty()){
                     resetValueFunction();//if no vector is saved in memory, calculate objective from the beginning
-                    finite_stack.push(calculateValues(k, 0, getStateValues(states), true));
+                    finite_stack.push(calculateValues(k, 0, getValueFunction(), true));
                     index_stack.push(k);
-                    stack_memory += states.size()*sizeof(pair<int,float>);
+                    stack_memory += finite_stack.slot_bytes();
                 if (stack_memory > max_stack_memory)
                     max_stack_memory = stack_memory;
                 }
                 else{
                     if (index_stack.top() != k){
-                        finite_stack.push(calculateValues(k, index_stack.top(), finite_stack.top(), true));//use last saved vector in memory to calculate objective
+                        finite_stack.top(V);
+                        finite_stack.push(calculateValues(k, index_stack.top(), V, true));//use last saved vector in memory to calculate objective
                         index_stack.push(k);
-                        stack_memory += states.size()*sizeof(pair<int,float>);
+                        stack_memory += finite_stack.slot_bytes();
                         if (stack_memory > max_stack_memory)
                             max_stack_memory = stack_memory;
                     }
@@ -1134,9 +1189,85 @@ void rootEvaluationcorr(int horizon){
     }
 
 
+    //largest number of steps the revolve method can reverse with c checkpoints computing every step at most t times, C(c+t+1, t) - 1
+    long long _revolve_capacity(int c, int t){
+        if (t <= 0) return 0;
+        long long b = 1;
+        for (int i = 1; i <= t; i++){
+            b = b * (c + 1 + i) / i; //C(c+1+i, i), exact
+            if (b > (1LL << 40)) return 1LL << 40;
+        }
+        return b - 1;
+    }
+
+    /*
+    Binomial split of the revolve method: with the value function of step l available and c free checkpoints,
+    the value function of step l+j is computed and stored first. The smallest t with _revolve_capacity(c, t) >= n
+    is the number of times the worst step must be computed; the lower part (j-1 steps, c checkpoints) and the upper
+    part (n-j steps, c-1 checkpoints) are then sized so that both use their capacity, which minimizes the total steps.
+    Takes as input the number of steps to reverse and the free checkpoints (at least 1).
+    Returns j.
+    */
+    int _revolve_split(int n, int c){
+        int t = 1;
+        while (_revolve_capacity(c, t) < n) t++;
+        long long lower = max(_revolve_capacity(c, t - 2), (long long)n - 1 - _revolve_capacity(c - 1, t));
+        return min((long long)n, lower + 1);
+    }
+
+    /*
+    Executes the actions of steps l+n down to l+1, the value function of step l being the top of finite_stack
+    (or the zero value function when l is 0), keeping at most c more checkpoints.
+    No output.
+    */
+    void _revolve_reverse(int l, int n, int c, ValueFunction &V){
+        while (n > 0){
+            int j = (c > 0) ? _revolve_split(n, c) : n;
+            if (l == 0){
+                resetValueFunction();
+                getValueFunction(V);
+            }
+            else
+                finite_stack.top(V);
+            calculateValuestestcorrR(l + j, l, V, true);
+            recomputed_backups += j;
+            if (l + j == revolve_horizon)
+                expected_reward = V.values[initial_state_num];
+            if (j < n){
+                finite_stack.push(V);
+                _revolve_reverse(l + j, n - j, c - 1, V);
+                finite_stack.top(V);
+                finite_stack.pop();
+            }
+            takeAction2(V.best_qstates[current_state_num], l + j);
+            checkMemoryUsage();
+            n = j - 1;
+        }
+    }
+
+    /*
+    Runs the Finite-Horizon MDP with binomial (Revolve) checkpointing: the actions are executed from the last step
+    of the horizon to the first, every value function being recomputed from the closest stored checkpoint, with at
+    most checkpoint_budget checkpoints. For a given budget this needs the fewest recomputed steps of any schedule:
+    about H*t steps, t being the smallest number with C(budget+t+1, t) > H.
+    Takes as argument the Finite-Horizon MDP's horizon.
+    */
+    void revolveEvaluation(int horizon){
+        int budget = checkpoint_budget;
+        if (budget < 0)
+            budget = floor(log2(horizon + 1));
+        revolve_horizon = horizon;
+        revolve_budget = budget;
+        recomputed_backups = 0;
+        finite_stack.reserve(budget, states.size());
+        ValueFunction V;
+        _revolve_reverse(0, horizon, budget, V);
+        max_stack_memory = finite_stack.peak_memory();
+    }
+
     void infiniteEvaluation(int horizon){
         resetValueFunction();
-        max_memory_used=value_iteration(0.1, false);
+        max_memory_used=value_iteration(0.1, false, false, infinite_solver);
         max_memory_used = getValue();
         expected_reward = states[initial_state_num].value;
         for (int time = horizon; time > 0; time--){
@@ -1145,14 +1276,13 @@ void rootEvaluationcorr(int horizon){
     }
     
     void infiniteMEvaluation(int horizon){
-        vector<pair<int,float>> V;
+        ValueFunction V;
         int steps_remaining = horizon;
         resetValueFunction();
-        V =getStateValuestest(states);
+        getValueFunction(V);
         calculateValuestestcorrR(steps_remaining, 0, V,true);
-        expected_reward = V[initial_state_num].second;
-        loadValueFunctiontest(V);
-        takeAction2(V[current_state_num].first, steps_remaining);
+        expected_reward = V.values[initial_state_num];
+        takeAction2(V.best_qstates[current_state_num], steps_remaining);
         steps_made++;
         steps_remaining--;
         if (getValue() > max_memory_used){
@@ -1160,11 +1290,11 @@ void rootEvaluationcorr(int horizon){
         }
         while(steps_remaining > 0){
             //resetValueFunction();
-            //V=getStateValuestest(states);
+            //getValueFunction(V);
             //calculateValuestestcorrR(steps_remaining, 0, V,true);
-            //loadValueFunctiontest(V);
+            //loadValueFunction(V);
             //takeAction(false, steps_remaining);
-            takeAction2(V[current_state_num].first, steps_remaining);
+            takeAction2(V.best_qstates[current_state_num], steps_remaining);
             steps_made++;
             steps_remaining--;
         }
@@ -1180,68 +1310,165 @@ void rootEvaluationcorr(int horizon){
         }
     }
 
+    /*
+    Solves the model once for the given algorithm and executes num_rollouts independent trajectories of its policy
+    from the initial state, split between the threads of sweep_pool. Every finite method executes the same
+    time-indexed policy, so it is computed once with calculatePolicycorr and read from action_stack (layer t-1 with
+    t steps remaining); the infinite methods execute one stationary policy. Rollout r draws from its own engine,
+    seeded with (seed, r), so the rewards do not depend on the number of threads. The current state, total_reward
+    and eng of the model are not changed.
+    Takes as input the algorithm, the horizon, the number of rollouts, the seed of the rollouts and the z value of the confidence interval.
+    Returns the summary of the total rewards collected.
+    */
+    RolloutStats rolloutEvaluation(model_type alg, int horizon, int num_rollouts, int seed = 21, float z = 1.96){
+        build_reward_tables();
+        transition_store.build_cumulative(states.size());
+        bool time_indexed = (alg != infinite && alg != infiniteM);
+        vector<int> stationary; //best QState of every state
+        resetValueFunction();
+        if (alg == infinite){
+            value_iteration(0.1, false, false, infinite_solver);
+            stationary = getStateActions();
+            expected_reward = states[initial_state_num].value;
+        }
+        else if (alg == infiniteM){
+            ValueFunction V;
+            getValueFunction(V);
+            calculateValuestestcorrR(horizon, 0, V, true);
+            stationary = V.best_qstates;
+            expected_reward = V.values[initial_state_num];
+        }
+        else
+            expected_reward = calculatePolicycorr(horizon);
+
+        vector<float> rewards(max(0, num_rollouts), 0.0);
+        sweep_pool.run(rewards.size(), [&](int first, int last){
+            uniform_real_distribution<float> u(0, 1);
+            for (int r = first; r < last; r++){
+                seed_seq stream{seed, r};
+                default_random_engine e(stream);
+                int s = initial_state_num;
+                float collected = 0.0;
+                for (int t = horizon; t > 0; t--){
+                    QState &qs = states[s].qstates[time_indexed ? action_stack.at(t - 1, s) : stationary[s]];
+                    int next = _sample_next(qs, u(e));
+                    if (next >= 0){ //otherwise rounding left the draw above the total probability, stay
+                        collected += qs.get_reward(next, t);
+                        s = next;
+                    }
+                }
+                rewards[r] = collected;
+            }
+        });
+        if (time_indexed)
+            action_stack.reserve(1, states.size()); //releases the policy
+        return RolloutStats(rewards, z);
+    }
+
+    /*
+    Runs rolloutEvaluation and prints the summary of the rewards next to the expected reward.
+    Takes as argument the algorithm, the horizon, the number of rollouts and their seed.
+    */
+    void runRollouts(model_type alg, int horizon, int num_rollouts, int seed = 21){
+        auto start = high_resolution_clock::now();
+        RolloutStats stats = rolloutEvaluation(alg, horizon, num_rollouts, seed);
+        auto stop = high_resolution_clock::now();
+        auto duration = duration_cast<microseconds>(stop - start);
+        *output << "ROLLOUTS OF THE POLICY: " << endl;
+        *output << "Horizon size: " << horizon << endl;
+        *output << "Rollouts: " << stats.num_rollouts << endl;
+        *output << "Total Reward Expected: " << expected_reward << endl;
+        *output << "Mean Reward Collected: " << stats.mean << endl;
+        *output << "Reward variance: " << stats.variance << ", standard error: " << stats.std_error << endl;
+        *output << "95% confidence interval: [" << stats.ci_low << ", " << stats.ci_high << "]" << endl;
+        *output << "Reward range: [" << stats.min_reward << ", " << stats.max_reward << "]" << endl;
+        *output << "Execution time (sec): " << duration.count() * 0.000001 << endl;
+        *output << endl;
+    }
+
     void runAlgorithm(model_type alg, int horizon=100){
 
         auto start = high_resolution_clock::now();
+        build_reward_tables(); //the model does not change during the evaluation
+        transition_store.build_cumulative(states.size());
         switch(alg) {   
             case infinite:
-                cout << "INFINITE MDP MODEL: " << endl;
+                *output << "INFINITE MDP MODEL: " << endl;
                 init_memory_used = getValue();
                 infiniteEvaluation(horizon);
 
                 break;
             case infiniteM:
-                cout << "INFINITEM MDP MODEL: " << endl;
+                *output << "INFINITEM MDP MODEL: " << endl;
                 init_memory_used = getValue();
                 //infiniteEvaluationM(horizon);
                 infiniteMEvaluation(horizon);
 
                 break;
             case naive:
-                cout << "NAIVE FINITE MDP MODEL: " << endl;
+                *output << "NAIVE FINITE MDP MODEL: " << endl;
                 init_memory_used = getValue();
                 naiveEvaluationcorr(horizon);
                 //naiveEvaluation2(horizon);
 
                 break;
             case root:
-                cout << "ROOT FINITE MDP MODEL: " << endl;
+                *output << "ROOT FINITE MDP MODEL: " << endl;
                 init_memory_used = getValue();
                 rootEvaluationcorr(horizon);
                 //rootEvaluation2(horizon);
 
                 break;
             case tree:
-                cout << "TREE FINITE MDP MODEL: " << endl;
+                *output << "TREE FINITE MDP MODEL: " << endl;
                 init_memory_used = getValue();
                 treeEvaluation2(horizon);
                 //treeEvaluationcorr(horizon);
 
                 break;
             case inplace:
-                cout << "IN-PLACE FINITE MDP MODEL: " << endl;
+                *output << "IN-PLACE FINITE MDP MODEL: " << endl;
                 init_memory_used = getValue();
                 inPlaceEvaluation3(horizon);
 
+                break;
+            case revolve:
+                *output << "REVOLVE FINITE MDP MODEL: " << endl;
+                init_memory_used = getValue();
+                revolveEvaluation(horizon);
+
                 break;
             default:
-                cout << "Invalid Model Type. Valid model types are: infinite, naive, root, tree, inplace" << endl;
+                *output << "Invalid Model Type. Valid model types are: infinite, naive, root, tree, inplace, revolve" << endl;
                 return;
         }
 
         auto stop = high_resolution_clock::now();
         auto duration = duration_cast<microseconds>(stop - start);
-        cout << "Horizon size: " << horizon << endl;
-        cout << "Total Reward Expected: " << expected_reward << endl;
-        cout << "Total Reward Collected: " << total_reward << endl;
-        cout << "Execution time (sec): " << duration.count() * 0.000001 << endl;
-        cout << "Peak memory used (MB): " << (max_memory_used) / 1000000.0 << endl;
-        cout << "Peak memory used (MB): " << (init_memory_used) / 1000000.0 << endl;
-         cout << "Peak memory used (MB): " << (max_memory_used-init_memory_used) << endl;
-        //cout << "(" << horizon << "," << duration.count() * 0.000001 << ")";
-        cout << endl;
+        execution_time = duration.count() * 0.000001;
+        *output << "Horizon size: " << horizon << endl;
+        *output << "Total Reward Expected: " << expected_reward << endl;
+        *output << "Total Reward Collected: " << total_reward << endl;
+        *output << "Execution time (sec): " << duration.count() * 0.000001 << endl;
+        *output << "Peak memory used (MB): " << (max_memory_used) / 1000000.0 << endl;
+        *output << "Peak memory used (MB): " << (init_memory_used) / 1000000.0 << endl;
+         *output << "Peak memory used (MB): " << (max_memory_used-init_memory_used) << endl;
+        if (alg == revolve)
+            *output << "Recomputed steps: " << recomputed_backups << " with " << revolve_budget << " checkpoints" << endl;
+        if (alg == root || alg == tree || alg == revolve){
+            *output << "Peak checkpoint memory (bytes): " << max_stack_memory << " (" << finite_stack.peak << " of " << finite_stack.capacity << " slots)" << endl;
+            //restarting from a value off by e keeps it within e (finite-horizon backups are averages), so every
+            //action is at most 2e worse than the exact one and the expected reward drifts by at most 2e per step
+            if (finite_stack.codec != checkpoint_full)
+                *output << "Checkpoint value error: " << finite_stack.worst_error << ", expected reward deviation bound: " << 2 * finite_stack.worst_error * horizon << endl;
+            if (finite_stack.full_slots > 0)
+                *output << "Checkpoints kept in float to meet the bound of the codec: " << finite_stack.full_slots << endl;
+        }
+        //*output << "(" << horizon << "," << duration.count() * 0.000001 << ")";
+        *output << endl;
     }
 
 
 
 };
+#endif
@@ -1,9 +1,13 @@
+#ifndef MDPMODEL_H
+#define MDPMODEL_H
 #include <iostream>
 #include <vector>
 #include <map>
 #include <stdexcept>
 #include <string>
 #include <stack>
+#include <queue>
+#include <deque>
 #include <sstream>
 #include "stdlib.h"
 #include "stdio.h"
@@ -12,6 +16,15 @@
 #include <math.h>
 #include <array>
 #include <chrono>
+#include <algorithm>
+#include "TransitionStore.h"
+#include "StateIndex.h"
+#include "SweepPool.h"
+#include "BellmanKernel.h"
+#include "ModelSnapshot.h"
+#include "TraceFile.h"
+#include <unordered_map>
+#include <atomic>
 #ifdef _WIN32
 #include <windows.h>
 #include <psapi.h>
@@ -46,7 +59,7 @@ int parseLine(char* line){
     return i;
 }
 
-string printableParameters(map<string,pair<float,float>> params){
+string printableParameters(const map<string,pair<float,float>> &params){
     string s = "[";
     for (auto& element:params){
         s = s + "(";
@@ -84,71 +97,50 @@ SIZE_T getValue1(){
 
 class QState{
 public:
-    pair<string,int> action;
+    int action;                    //id of the action in MDPModel::actions
     int num_taken;
     float qvalue;
-    vector<int> transitions={};
-    vector<float> rewards = {};
+    TransitionStore* store = NULL; //sparse transitions/rewards, owned by the model
+    int row = -1;                  //row of this QState in the store
     int num_states;
-    vector<int> transtate={};
-    vector<float> trans={};
     float upper_bound;//Maximum value of QStates for a given state
     float lower_bound;//Minimum value of QStates for a given state
 
-    QState(pair<string,int> actionn, int numstates, float qvaluee){
+    QState(int actionn, int numstates, float qvaluee, TransitionStore* storee = NULL){
         action = actionn;
         num_taken = 0;
         qvalue = qvaluee;
         num_states = numstates;
-        if (num_states > 0){
-            for (int i=0; i< num_states;i++){
-            transitions.push_back(0);
-            rewards.push_back(0.0);
-            }
-        }
+        store = storee;
+        if (store != NULL)
+            row = store->add_row();
 
     }
 
     QState(){
-        std::string s0 ("NOT SET");
-        action.first = s0;
-        action.second = -1;
+        action = -1; //NOT SET
         num_taken = 0;
         qvalue = 0.0;
         num_states = -1;
-        if (num_states > 0){
-            for (int i=0; i< num_states;i++){
-            transitions.push_back(0);
-            rewards.push_back(0.0);
-            }
-        }
-
-    }
 
-    ~QState(){
-        transitions.clear();
-        transitions.shrink_to_fit();
-        rewards.clear();
-        rewards.shrink_to_fit();
     }
 
     void update(int state_num, float reward){
         num_taken++;
-        transitions[state_num] += 1;
-        rewards[state_num] += reward;
+        store->update(row, state_num, reward);
     }
 
 
-    pair<string, int> get_action(){
+    int get_action() const{
         return action;
     }
 
-    float get_qvalue(){
+    float get_qvalue() const{
         return qvalue;
     }
 
     bool has_transition(int state_num){
-        return (transitions[state_num] > 0);
+        return (store->find(row, state_num) >= 0);
     }
 
 
@@ -157,40 +149,43 @@ public:
             return (1.0 /(float)num_states);
         }
         else{
-            return ((float)transitions[state_num]*1.0 /(float)num_taken*1.0);
+            int pos = store->find(row, state_num);
+            if (pos < 0) return 0.0;
+            return store->probabilities[pos];
         }
     }
 
     int get_num_transitions(int state_num){
-        return transitions[state_num];
+        int pos = store->find(row, state_num);
+        if (pos < 0) return 0;
+        return store->counts[pos];
     }
 
 
     float get_reward(int state_num){
-        if (transitions[state_num] == 0)
+        int pos = store->find(row, state_num);
+        if (pos < 0)
             return 0.0;
         else
-            return (rewards[state_num] / (float)transitions[state_num]);
+            return store->mean_rewards[pos];
     }
 
     float get_reward(int state_num, int time_step, float reward_factor = 0.8){
 
-        if (transtate.size() < 2){
+        int first = store->begin(row);
+        int size = store->size(row);
+        if (size < 2){
             return get_reward(state_num);
         }
         
 
-        float static_reward;
-        if (transitions[state_num] == 0)
-            static_reward = 0.0;
-        else
-            static_reward = (rewards[state_num] / (float)transitions[state_num]);
+        float static_reward = get_reward(state_num);
         
-        if (state_num == transtate[0]){
+        if (state_num == store->successors[first]){
             return reward_factor * static_reward;
         }
-        else if (state_num == transtate[time_step % transtate.size()]){
-           return static_reward + ((1 - reward_factor)* get_reward(transtate[0]) * trans[0]) / (get_transition(state_num));
+        else if (state_num == store->successors[first + time_step % size]){
+           return static_reward + ((1 - reward_factor)* store->mean_rewards[first] * store->probabilities[first]) / (get_transition(state_num));
         }
         else{
             return static_reward;
@@ -204,21 +199,40 @@ public:
         }*/
     }
 
+    /*
+    Difference between the time-varying and the static expected reward of this QState at the given time step:
+    sum over successors of p * (get_reward(s', time_step) - get_reward(s')). Only the first successor and
+    the one selected by time_step differ, so a backup can use the static rewards and add this correction.
+    */
+    float reward_correction(int time_step, float reward_factor = 0.8){
+        int first = store->begin(row);
+        int size = store->size(row);
+        if (size < 2)
+            return 0.0;
+        if (store->has_reward_table(reward_factor)) //depends on time_step only through its phase
+            return store->reward_corrections[first + time_step % size];
+        float correction = store->probabilities[first] * (get_reward(store->successors[first], time_step, reward_factor) - store->mean_rewards[first]);
+        int k = first + time_step % size;
+        if (k != first)
+            correction += store->probabilities[k] * (get_reward(store->successors[k], time_step, reward_factor) - store->mean_rewards[k]);
+        return correction;
+    }
+
     void set_qvalue(float qvaluee){
         qvalue = qvaluee;
     }
 
-    int get_num_taken(){
+    int get_num_taken() const{
         return num_taken;
     }
 
 
-    vector<int> get_transitions(){
-        return transitions;
-    }
-
-    vector<float> get_rewards(){
-        return rewards;
+    /*
+    Observed successors of this QState with their counts, reward sums, probabilities and mean rewards, without copying.
+    Empty for a QState never taken (uniform prior).
+    */
+    TransitionStore::RowView get_transitions() const{
+        return store->view(row);
     }
 
     friend ostream &operator<<( ostream &output, const QState& q);
@@ -226,7 +240,7 @@ public:
 };
 
 ostream &operator<<( ostream &output, const QState& q){ 
-         output << "Action: "<< q.action.first<<"\tQ-value: "<< q.qvalue << "\tTaken: "<< q.num_taken << "\tUpper Bound: "<< q.upper_bound << endl;
+         output << "Action: "<< q.action<<"\tQ-value: "<< q.qvalue << "\tTaken: "<< q.num_taken << "\tUpper Bound: "<< q.upper_bound << endl;
          return output;            
 }
 
@@ -240,35 +254,41 @@ public:
     int best_qstate;
     bool isBestQStateSet = false;
     int num_visited;
-    map<string,pair<float,float>> parameters;
+    const StateIndex* schema; //parameter bins shared by every state of the model, the bins of this state are the digits of state_num
     //float max_lower_bound = -INFINITY;
     float max_lower_bound;
 
-    State(map<string,pair<float,float>> parameterss = {} , int statenum = 0, float initialvalue = 0.0, int numstates = 0){
+    State(const StateIndex* schemaa = NULL, int statenum = 0, float initialvalue = 0.0, int numstates = 0){
         value = 0.0;
         num_visited = 0;
         state_num   = statenum;
         num_states  = numstates;
         value = initialvalue;
-        parameters = parameterss;
+        schema = schemaa;
+        best_qstate = 0;
         isBestQStateSet  = false;
         vector<QState> qstates = {};
         //max_lower_bound = -INFINITY;
     }
 
+    //a State owns the QStates of one grid cell: it is moved into the states of the model, never copied
+    State(const State&) = delete;
+    State(State&&) = default;
+    State& operator=(const State&) = delete;
+    State& operator=(State&&) = default;
+
     ~State(){
         qstates.clear();
         //cout << "Deleting State " << state_num << endl;
         //std::vector<QState>().swap(qstates);
         qstates.shrink_to_fit();
-        parameters.clear();
     }
 
     void visit(){
         num_visited++;
     }
 
-    int get_state_num(){
+    int get_state_num() const{
         return state_num;
     }
 
@@ -276,7 +296,7 @@ public:
         num_states = numstates;
     }
 
-    float get_value(){
+    float get_value() const{
         return value;
     }
 
@@ -284,11 +304,11 @@ public:
         return best_qstate;
     }*/
 
-    int get_best_qstate(){
+    int get_best_qstate() const{
         return best_qstate;
     }
 
-    pair<string,int> get_optimal_action(){
+    int get_optimal_action(){
         return qstates[best_qstate].get_action();
     }
 
@@ -313,19 +333,23 @@ public:
         isBestQStateSet = true;
     }
 
-    map<string,pair<float,float>> get_parameters(){
-        return parameters;
-    } 
-
-    void add_new_parameter(string name, pair<float,float> values){
-        parameters[name] = values;
+    /*
+    Builds the parameter bins of the state from the schema, for printing.
+    Returns an empty map for a state without schema (or the placeholder of lazy mode).
+    */
+    map<string,pair<float,float>> get_parameters() const{
+        map<string,pair<float,float>> params;
+        if (schema == NULL || state_num < 0) return params;
+        for (int i = 0; i < schema->params.size(); i++)
+            params[schema->params[i].name] = schema->limits_of(state_num, i);
+        return params;
     }
 
     pair<bool,pair<float,float>> get_parameter(string param){
-        for (auto& x:parameters){
-            if (x.first == param)
-                return make_pair(true, x.second);
-        }
+        int i = (schema == NULL || state_num < 0) ? -1 : schema->find_parameter(param);
+        if (i < 0)
+            return make_pair(false, make_pair(0.0f, 0.0f));
+        return make_pair(true, schema->limits_of(state_num, i));
     }
 
 
@@ -337,12 +361,12 @@ public:
         }
     }
 
-    vector<QState> get_qstates(){
+    const vector<QState>& get_qstates() const{
         return qstates;
     }
 
 
-    QState* get_qstate(pair<string, int> &action){
+    QState* get_qstate(int action){
 
         for (int i=0; i < qstates.size(); i++){
             if (qstates[i].get_action() == action)
@@ -350,9 +374,9 @@ public:
         }
     }
 
-    vector<pair<string, int>> get_legal_actions(){
+    vector<int> get_legal_actions(){
 
-        vector<pair<string, int>> actions;
+        vector<int> actions;
         for (auto & element : qstates){
             actions.push_back(element.get_action());
         }
@@ -361,34 +385,64 @@ public:
 
     friend ostream &operator<<(ostream &output, State& s);
 
-    void print_detailed(){
-        cout << state_num << ": " << printableParameters(parameters) << ", visited: "<< num_visited << "\tMax Lower Bounds: "<< max_lower_bound <<endl;
+    void print_detailed(vector<pair<string,int>> &actions){
+        cout << state_num << ": " << printableParameters(get_parameters()) << ", visited: "<< num_visited << "\tMax Lower Bounds: "<< max_lower_bound <<endl;
         for (auto& qs:this->get_qstates())
-            cout << qs << endl;
+            cout << actions[qs.action].first << " " << actions[qs.action].second << ", " << qs << endl;
     }
 
 
 };
 
 ostream &operator<<(ostream &output, State& s){
-        output << s.state_num << ": " << printableParameters(s.parameters) <<endl;
+        output << s.state_num << ": " << printableParameters(s.get_parameters()) <<endl;
         return output;
 }
 
 
 
+/*
+Solvers of MDPModel::value_iteration:
+jacobi backs up every state from a snapshot of the previous sweep,
+gauss_seidel backs up the states in place so that later states already use the new values,
+prioritized backs up one state at a time, picking the state with the largest bound on its Bellman residual,
+modified_policy alternates policy improvement with policy_sweeps evaluation sweeps of the current policy,
+policy_iteration evaluates every policy exactly, solving its linear system with BiCGSTAB.
+Both policy solvers need discount < 1 (the system is singular otherwise): value_iteration runs jacobi instead.
+*/
+enum vi_solver {jacobi, gauss_seidel, prioritized, modified_policy, policy_iteration};
+
 class MDPModel{
     public:
         float discount;
-        vector<State> states = {State()};
+        vector<State> states = vector<State>(1); //States are only moved, an initializer list would copy them
         vector<string> index_params = {};
+        StateIndex state_index;           //measurements -> state number, built alongside the states
+        vector<pair<string,int>> actions = {}; //action table, the id of an action is its index
+        vector<int> action_vm_change = {};     //change in number_of_VMs caused by every action
+        SweepPool sweep_pool;                  //threads sharing the states of every Bellman sweep
         int current_state_num;
         int initial_state_num;
         json parameters = {};
+        TransitionStore transition_store; //sparse transitions and rewards of every QState
         float update_error = 0.1;
+        int policy_sweeps = 5;            //evaluation sweeps per improvement of modified policy iteration
+        bool policy_discount_warned = false; //value_iteration fell back to jacobi for a discount of 1 or more
         bool update_algorithm;
+        bool incremental_update = false;  //with update_algorithm false, update() runs _local_value_iteration instead of value_iteration
+        int local_backup_limit = 1000;    //backups of one _local_value_iteration call, 0 for no limit
+        vector<vector<int>> local_predecessors = {}; //states that can reach every state, built by _build_local_index
+        vector<int> local_untaken = {};   //QStates of every state never taken (uniform prior, they depend on every state)
+        vector<char> local_queued = {};   //states currently in local_work
+        vector<float> local_pending = {}; //bound on the change of every state caused by its successors since its last backup
+        deque<int> local_work = {};       //states left to back up, kept across updates when the limit is hit
+        float local_uniform_drift = 0.0;  //bound on the change of the states with untaken QStates, not yet backed up
         int max_VMs;
         int min_VMs;
+        bool lazy_states = false;          //"lazy_states" of the configuration, see _materialize
+        int num_potential_states = 1;      //states of the whole parameter grid
+        unordered_map<int,int> state_slots = {}; //lazy mode: number of a materialized state -> its slot in states
+        float initial_qvalue = 0.0;        //initial_qvalues of the configuration
         
     MDPModel(json conf = json({}), bool upd_alg = true){
         if (conf.contains("discount"))
@@ -397,17 +451,18 @@ class MDPModel{
         if (conf.contains("parameters"))
         parameters = _get_params(conf["parameters"]);
 
+        if (conf.contains("lazy_states"))
+        lazy_states = conf["lazy_states"];
+
         for (auto& element : parameters.items()) {
             index_params.push_back(element.key());
-            _update_states(element.key(), element.value());
+            state_index.add_parameter(element.key(), element.value()["values"]);
         }
 
+        num_potential_states = state_index.num_states;
+        if (!lazy_states)
+            _build_states();
 
-        int num_states = states.size();
-
-        for (auto & element : states){
-            element.set_num_states(num_states);
-        }
         if (conf.contains("actions")){
         _set_maxima_minima(parameters, conf["actions"]);
 
@@ -415,9 +470,14 @@ class MDPModel{
             _add_qstates(conf["actions"], conf["initial_qvalues"]);
         }
         update_algorithm  = upd_alg;
+        _set_update_mode(conf);
             
     };
 
+    //QStates point to transition_store, so a copy would share (and outlive) the original's store
+    MDPModel(const MDPModel&) = delete;
+    MDPModel& operator=(const MDPModel&) = delete;
+
 
     json _get_params(json par){
         json new_pars;
@@ -443,42 +503,108 @@ class MDPModel{
         return new_pars;
     }
 
-    void set_state(json measurements){
-        current_state_num = _get_state(measurements);
+    void set_state(const json &measurements){
+        current_state_num = lazy_states ? _materialize(state_index.get_state(measurements)) : _get_state(measurements);
+    }
+
+    void set_state(const double* measurements){
+        current_state_num = lazy_states ? _materialize(state_index.get_state(measurements)) : state_index.get_state(measurements);
+    }
+
+    /*
+    Builds every state of the grid of state_index in one pass: the number of states is known once the parameters
+    are added, so the array is allocated once and the bins of a state are the digits of its number.
+    No input.
+    No output.
+    */
+    void _build_states(){
+        int num_states = state_index.num_states;
+        states.clear();
+        states.reserve(num_states);
+        for (int statenum = 0; statenum < num_states; statenum++)
+            states.emplace_back(&state_index, statenum, 0.0, num_states);
+    }
+
+    /*
+    Finds the state containing the given measurements through state_index, in O(P*log B).
+    In lazy mode this is its slot, slot 0 if it is not materialized.
+    Returns -1 if a measurement lies outside the bins of its parameter.
+    */
+    int _get_state(const json &measurements){
+        return lazy_states ? _slot(state_index.get_state(measurements)) : state_index.get_state(measurements);
     }
 
-    void _update_states(string name, json new_parameter){
-        int statenum = 0;
-        vector<State> new_states ={};
-        for (auto& x:new_parameter["values"]){
-            for (auto& s:states){
-                map<string,pair<float,float>> last;
-                last = s.get_parameters();
-                State new_state(last, statenum);
-                new_state.add_new_parameter(name, x);
-                new_states.push_back(new_state);
-                statenum++;
+    //measurements laid out in the order of index_params
+    int _get_state(const double* measurements){
+        return lazy_states ? _slot(state_index.get_state(measurements)) : state_index.get_state(measurements);
+    }
+
+    /*
+    Lazy mode (lazy_states): instead of the whole grid of num_potential_states states, states holds the states met
+    while learning, materialized the first time they are met, behind a placeholder in slot 0 that stands for every
+    state not materialized yet. Such states have only QStates never taken, so they all share one value, the value of
+    slot 0, and a sum over every state of the grid counts slot 0 (num_potential_states - states.size() + 1) times.
+    Transitions, value functions and policies use slots; State::state_num keeps the number of the state in the grid.
+    Takes as input the number of a state in the grid.
+    Returns its slot, materializing it if needed, or -1 for -1 (measurements outside the bins).
+    */
+    int _materialize(int state_num){
+        if (state_num < 0) return -1;
+        auto found = state_slots.find(state_num);
+        if (found != state_slots.end()) return found->second;
+        int slot = states.size();
+        State s(&state_index, state_num, 0.0, num_potential_states);
+        for (int act = 0; act < actions.size(); act++){
+            if (_is_permissible(s, actions[act])){
+                QState q(act, num_potential_states, states[0].get_value(), &transition_store); //the value it had as part of slot 0
+                s.add_qstate(q);
             }
         }
-        states = new_states;
+        s.update_value();
+        states.push_back(std::move(s));
+        state_slots[state_num] = slot;
+        transition_store.successor_keys.push_back(state_num);
+        if (!local_predecessors.empty()){
+            local_predecessors.push_back(vector<int>());
+            local_untaken.push_back(states[slot].qstates.size()); //s has been moved into the slot
+            local_queued.push_back(0);
+            local_pending.push_back(0.0);
+        }
+        return slot;
     }
 
-    int _get_state(json measurements){
-        for (auto& s:states){
-            bool matches = true;
-            for (auto& par:s.get_parameters()){
-                float min_v = par.second.first;
-                float max_v = par.second.second;
-                if (measurements[par.first] < min_v || measurements[par.first] > max_v){
-                    matches = false;
-                    break;
-                }
-            }
-            if (matches) return s.state_num;
+    //lazy mode: slot of a state of the grid, 0 if it is not materialized, -1 for -1
+    int _slot(int state_num){
+        if (state_num < 0) return -1;
+        auto found = state_slots.find(state_num);
+        return (found == state_slots.end()) ? 0 : found->second;
+    }
+
+    //lazy mode: states of the grid carried by slot 0 besides itself, 0 otherwise
+    float _unmaterialized_extra(){
+        return lazy_states ? (float)(num_potential_states - (int)states.size()) : 0.0f;
+    }
+
+    /*
+    Reads how update() refreshes the values from the configuration, overriding the default of the constructor:
+    "update_algorithm" true backs up the updated QState only, false runs value_iteration after every transition;
+    "incremental_update" true runs _local_value_iteration instead (and implies "update_algorithm" false),
+    with at most "local_backup_limit" backups per update.
+    Takes as input the configuration.
+    No output.
+    */
+    void _set_update_mode(const json &conf){
+        if (conf.contains("incremental_update")){
+            incremental_update = conf["incremental_update"];
+            if (incremental_update) update_algorithm = false;
         }
+        if (conf.contains("update_algorithm"))
+            update_algorithm = conf["update_algorithm"];
+        if (conf.contains("local_backup_limit"))
+            local_backup_limit = conf["local_backup_limit"];
     }
 
-    void _set_maxima_minima(json parameters, json acts){
+    void _set_maxima_minima(const json &parameters, const json &acts){
         if (acts.contains("add_VMs") || acts.contains("remove_VMs")){
             vector<int> vms;
             for (auto& x:parameters["number_of_VMs"]["values"]){
@@ -490,26 +616,88 @@ class MDPModel{
         }
     }
 
-    void _add_qstates(json acts, float initq){
-        int num_states = states.size();
+    /*
+    Builds the action table from the "actions" block of the configuration, once.
+    Actions are identified by their index in the table everywhere else, names are only kept for printing.
+    No output.
+    */
+    void _set_actions(json acts){
+        actions.clear();
+        action_vm_change.clear();
         for (auto& action:acts.items()){
             for (auto& val:action.value()){
-                pair<string,int> act = make_pair(action.key(), val);
-                for (auto& s:states){
-                        if (_is_permissible(s, act)){
-                            QState q(act, num_states, initq);
-                            s.add_qstate(q);
-                        }
-
-                }
+                int value = val;
+                actions.push_back(make_pair(action.key(), value));
+                if (action.key() == "add_VMs")
+                    action_vm_change.push_back(value);
+                else if (action.key() == "remove_VMs")
+                    action_vm_change.push_back(-value);
+                else
+                    action_vm_change.push_back(0);
             }
         }
+    }
 
+    //id of an action given by name, for input only
+    int get_action_id(pair<string,int> action){
+        for (int i = 0; i < actions.size(); i++){
+            if (actions[i] == action) return i;
+        }
+        return -1;
+    }
+
+    void _add_qstates(json acts, float initq){
+        int num_states = states.size();
+        _set_actions(acts);
+        initial_qvalue = initq;
+        if (lazy_states){ //only the placeholder, with one QState: its QStates all have the same value
+            states.clear();
+            states.push_back(State(&state_index, -1, 0.0, num_potential_states));
+            transition_store.successor_keys = {-1}; //rows in grid order, as in an eager model, whatever the order the states are reached
+            QState q(0, num_potential_states, initq, &transition_store);
+            states[0].add_qstate(q);
+            states[0].update_value();
+            return;
+        }
+        //one pass over the states, the QStates of a state allocated at once and given consecutive rows of the store
+        int vm_param;
+        vector<char> permissible = _permissible_bins(vm_param);
         for (auto& s:states){
+            const char* allowed = permissible.data() + (vm_param < 0 ? 0 : state_index.bin_of(s.state_num, vm_param)) * actions.size();
+            s.qstates.reserve(count(allowed, allowed + actions.size(), 1));
+            for (int act = 0; act < actions.size(); act++){
+                if (allowed[act]){
+                    s.qstates.emplace_back(act, num_states, initq, &transition_store);
+                    if (!s.isBestQStateSet) s.best_qstate = s.qstates.size() - 1;
+                }
+            }
             s.update_value();
         }
     }
 
+    /*
+    Evaluates _is_permissible for every action in every bin of number_of_VMs, the only parameter it depends on,
+    so that building the QStates compares no strings.
+    Takes as input where to put the index of number_of_VMs in state_index (-1 if the model has no such parameter).
+    Returns permissible[bin * actions.size() + action], one bin when the model has no number_of_VMs.
+    */
+    vector<char> _permissible_bins(int &vm_param){
+        vm_param = state_index.find_parameter("number_of_VMs");
+        int num_bins = (vm_param < 0) ? 1 : state_index.params[vm_param].limits.size();
+        vector<char> permissible(num_bins * actions.size(), 1);
+        if (vm_param < 0) return permissible;
+        for (int b = 0; b < num_bins; b++){
+            pair<float,float> limits = state_index.params[vm_param].limits[b];
+            for (int act = 0; act < actions.size(); act++){
+                if (actions[act].first == "add_VMs")
+                    permissible[b * actions.size() + act] = (max(limits.first, limits.second) + actions[act].second <= max_VMs);
+                else if (actions[act].first == "remove_VMs")
+                    permissible[b * actions.size() + act] = (min(limits.first, limits.second) - actions[act].second >= min_VMs);
+            }
+        }
+        return permissible;
+    }
+
     bool _is_permissible(State &s, pair<string,int> a){
         string action_type = a.first;
         int action_value = a.second;
@@ -527,29 +715,53 @@ class MDPModel{
         else return true;
     }
 
-    pair<string,int> suggest_action(){
+    int suggest_action(){
         return states[current_state_num].get_optimal_action();
     }
 
-    vector<pair<string, int>> get_legal_actions(){
+    vector<int> get_legal_actions(){
         return states[current_state_num].get_legal_actions();
     }
     
-    void update(pair<string,int> &action, json measurements, float reward){
+    /*
+    Convenience wrapper of update() below for json measurements.
+    */
+    void update(int action, const json &measurements, float reward){
+        vector<double> values(state_index.params.size());
+        state_index.get_values(measurements, values.data());
+        update(action, values.data(), reward);
+    }
+
+    /*
+    Records the transition caused by the given action from the current state and moves the agent to the next state.
+    Takes as input the action, the measurements after the action, laid out in the order of index_params
+    (see ComplexScenario::get_current_measurements(layout, values)), and the reward collected.
+    No output.
+    */
+    void update(int action, const double* measurements, float reward){
+        //find next state corresponding to current measurements, materialized first as it may move the states
+        int new_state = lazy_states ? _materialize(state_index.get_state(measurements)) : _get_state(measurements);
+
         states[current_state_num].visit(); //increase number of times visited by 1 for the current state
 
         QState* qstate = states[current_state_num].get_qstate(action); //find qstate corresponding to the chosen action
         if (qstate->num_states == -1) return;
-
-        int new_state = _get_state(measurements); //find next state corresponding to current measurements
         
+        int old_size = transition_store.size(qstate->row);
+        bool first_taken = qstate->get_num_taken() == 0;
         qstate->update(new_state, reward); //increase number of times taken, create transition between action and next state and assign reward
+        if (!local_predecessors.empty())
+            _update_local_index(current_state_num, new_state, first_taken, transition_store.size(qstate->row) > old_size);
         
         if (update_algorithm){
             _q_update(*qstate, states); //set qvalue of chosen action to new qvalue
             states[current_state_num].update_value(); //update the value of the current state, choosing the maximum of its qvalues
         }
 
+        else if (incremental_update){
+            _local_value_iteration(current_state_num, update_error);
+        }
+
         else{
             this->value_iteration(0.1); //execute Value Iteration
         }
@@ -559,19 +771,33 @@ class MDPModel{
 
 
     //UPDATE_FINITE: moves the agent to the new state after choosing an action without updating the model
-    void update_finite(pair<string,int> action, json measurements, float reward){
+    void update_finite(int action, const json &measurements, float reward){
         int new_state = _get_state(measurements);
         current_state_num = new_state; 
     }
 
+    void update_finite(int action, const double* measurements, float reward){
+        current_state_num = _get_state(measurements);
+    }
+
     void _q_update(QState &qstate, vector<State> &V){
         float new_qvalue = 0.0;
         float r;
         float t;
-        for (int i=0; i < V.size(); i++){
-            t = qstate.get_transition(i);
-            r = qstate.get_reward(i);
-            new_qvalue += t * (r + discount * V[i].get_value());
+        if (qstate.get_num_taken() == 0){ //never taken, every state is equally likely
+            t = qstate.get_transition(0);
+            for (int i=0; i < V.size(); i++)
+                new_qvalue += t * (0.0f + discount * V[i].get_value());
+            if (lazy_states)
+                new_qvalue += _unmaterialized_extra() * t * (0.0f + discount * V[0].get_value());
+        }
+        else{
+            TransitionStore &ts = *qstate.store;
+            for (int k = ts.begin(qstate.row); k < ts.end(qstate.row); k++){
+                t = ts.probabilities[k];
+                r = ts.mean_rewards[k];
+                new_qvalue += t * (r + discount * V[ts.successors[k]].get_value());
+            }
         }
         qstate.set_qvalue(new_qvalue);
     }
@@ -580,46 +806,81 @@ class MDPModel{
         float new_qvalue = 0.0;
         float r;
         float t;
-        for (int i=0; i < V.size(); i++){
-            t = qstate.get_transition(i);
-            r = qstate.get_reward(i, time_step);
-            new_qvalue += t * (r + discount * V[i].get_value());
+        if (qstate.get_num_taken() == 0){
+            t = qstate.get_transition(0);
+            for (int i=0; i < V.size(); i++)
+                new_qvalue += t * (0.0f + discount * V[i].get_value());
+            if (lazy_states)
+                new_qvalue += _unmaterialized_extra() * t * (0.0f + discount * V[0].get_value());
+        }
+        else{
+            TransitionStore &ts = *qstate.store;
+            for (int k = ts.begin(qstate.row); k < ts.end(qstate.row); k++){
+                t = ts.probabilities[k];
+                r = qstate.get_reward(ts.successors[k], time_step);
+                new_qvalue += t * (r + discount * V[ts.successors[k]].get_value());
+            }
         }
         qstate.set_qvalue(new_qvalue);
     }
 
  void _q_update2(QState &qstate, vector<float> &V){
         float new_qvalue = 0.0;
-        float r;
         float t;
-        for (int i=0; i < V.size(); i++){
-            t = qstate.get_transition(i);
-            r = qstate.get_reward(i);
-            new_qvalue += t * (r + discount * V[i]);
+        if (qstate.get_num_taken() == 0){
+            t = qstate.get_transition(0);
+            for (int i=0; i < V.size(); i++)
+                new_qvalue += t * (0.0f + discount * V[i]);
+            if (lazy_states)
+                new_qvalue += _unmaterialized_extra() * t * (0.0f + discount * V[0]);
+        }
+        else{
+            TransitionStore &ts = *qstate.store;
+            int first = ts.begin(qstate.row);
+            new_qvalue = bellman_backup(&ts.successors[first], &ts.probabilities[first], &ts.mean_rewards[first], ts.size(qstate.row), V.data(), 1, discount);
         }
         qstate.set_qvalue(new_qvalue);
     }
 
 void _q_update2(QState &qstate, vector<float> &V, int time_step){
         float new_qvalue = 0.0;
-        float r;
         float t;
-        for (int i=0; i < V.size(); i++){
-            t = qstate.get_transition(i);
-            r = qstate.get_reward(i, time_step);
-            new_qvalue += t * (r + V[i]);
+        if (qstate.get_num_taken() == 0){
+            t = qstate.get_transition(0);
+            for (int i=0; i < V.size(); i++)
+                new_qvalue += t * (0.0f + V[i]);
+            if (lazy_states)
+                new_qvalue += _unmaterialized_extra() * t * (0.0f + V[0]);
+        }
+        else{
+            TransitionStore &ts = *qstate.store;
+            int first = ts.begin(qstate.row);
+            new_qvalue = bellman_backup(&ts.successors[first], &ts.probabilities[first], &ts.mean_rewards[first], ts.size(qstate.row), V.data(), 1, 1.0f);
+            new_qvalue += qstate.reward_correction(time_step);
         }
         qstate.set_qvalue(new_qvalue);
     }
 
 
-    int value_iteration(float error = -1.0, bool verbose = false, bool useBounds = false ){
+    int value_iteration(float error = -1.0, bool verbose = false, bool useBounds = false, vi_solver solver = jacobi){
         if (error < 0){
             error = update_error;
         }
+        if (solver == gauss_seidel)
+            return _gauss_seidel_iteration(error, verbose, useBounds);
+        if (solver == prioritized)
+            return _prioritized_sweeping(error, useBounds);
+        if ((solver == modified_policy || solver == policy_iteration) && discount >= 1.0){
+            if (!policy_discount_warned)
+                cerr << "value_iteration: the policy solvers need a discount below 1, using jacobi" << endl;
+            policy_discount_warned = true;
+        }
+        else if (solver == modified_policy)
+            return _modified_policy_iteration(error, policy_sweeps);
+        else if (solver == policy_iteration)
+            return _policy_iteration(error);
         bool repeat = true;
-        float old_value;
-        float new_value;
+        atomic<bool> changed(false);
         int max=0;
         vector<float> V_tmp;
         //V_tmp.reserve(states.size());
@@ -639,21 +900,413 @@ void _q_update2(QState &qstate, vector<float> &V, int time_step){
                 printDetails(); //Just to print details for every state
             }
 
-            for (int j = 0 ; j < states.size(); j++ ){
-                for (int m = 0; m < states[j].get_qstates().size(); m++){
-                   _q_update2(states[j].qstates[m], V_tmp);
+            changed = false;
+            sweep_pool.run(states.size(), [&](int first, int last){
+                for (int j = first ; j < last; j++ ){
+                    for (int m = 0; m < states[j].qstates.size(); m++){
+                       _q_update2(states[j].qstates[m], V_tmp);
+                    }
+                    float old_value = states[j].get_value();
+                    states[j].update_value();
+                    float new_value = states[j].get_value();
+                    if (abs(old_value - new_value) > error)
+                        changed = true;
                 }
-                old_value = states[j].get_value();
-                states[j].update_value();
-                new_value = states[j].get_value();
-                if (abs(old_value - new_value) > error)
+            });
+            repeat = changed;
+            max=getValue1();
+            V_tmp.clear();
+        }
+        return max;
+    }
+    //backs up state j in place from V and stores its new value in V[j], returns the change of the value
+    float _backup_in_place(int j, vector<float> &V){
+        for (int m = 0; m < states[j].qstates.size(); m++){
+            _q_update2(states[j].qstates[m], V);
+        }
+        float old_value = states[j].get_value();
+        states[j].update_value();
+        V[j] = states[j].get_value();
+        return abs(V[j] - old_value);
+    }
+
+    /*
+    Builds the reverse-successor lists used by _local_value_iteration from the transitions recorded so far.
+    update() keeps them up to date afterwards.
+    No input.
+    No output.
+    */
+    void _build_local_index(){
+        int num_states = states.size();
+        TransitionStore &ts = transition_store;
+        local_predecessors.assign(num_states, vector<int>());
+        local_untaken.assign(num_states, 0);
+        local_queued.assign(num_states, 0);
+        local_pending.assign(num_states, 0.0);
+        local_work.clear();
+        local_uniform_drift = 0.0;
+        for (int i = 0; i < num_states; i++){
+            for (auto& qs:states[i].qstates){
+                if (qs.get_num_taken() == 0){
+                    local_untaken[i]++;
+                    continue;
+                }
+                for (int k = ts.begin(qs.row); k < ts.end(qs.row); k++){
+                    vector<int> &pred = local_predecessors[ts.successors[k]];
+                    if (pred.empty() || pred.back() != i) pred.push_back(i);
+                }
+            }
+        }
+    }
+
+    //records a transition from state to new_state in the local index
+    void _update_local_index(int state, int new_state, bool first_taken, bool new_successor){
+        if (first_taken) local_untaken[state]--;
+        if (new_successor){
+            vector<int> &pred = local_predecessors[new_state];
+            if (find(pred.begin(), pred.end(), state) == pred.end()) pred.push_back(state);
+        }
+    }
+
+    void _queue_local(int j){
+        local_pending[j] = 0.0;
+        if (local_queued[j]) return;
+        local_queued[j] = 1;
+        local_work.push_back(j);
+    }
+
+    /*
+    Incremental value iteration after one observed transition: backs up the given state and propagates the change
+    of every backed up state to the states that can reach it. Each of them accumulates the bound discount * change
+    on its own change and is queued once the bound exceeds error. States with a QState never taken depend on every
+    state through the uniform prior; they share one bound, discount/num_states * change, and are queued together. The work of a call is bounded by local_backup_limit,
+    states still queued are backed up by the next calls.
+    Takes as input the state whose QState was just updated and the error.
+    No output.
+    */
+    void _local_value_iteration(int state, float error){
+        if (local_predecessors.size() != states.size())
+            _build_local_index();
+        float uniform_weight = discount / (float)num_potential_states;
+        _queue_local(state);
+        int backups = 0;
+        while (!local_work.empty()){
+            if (local_backup_limit > 0 && backups == local_backup_limit) break;
+            int j = local_work.front();
+            local_work.pop_front();
+            local_queued[j] = 0;
+            backups++;
+
+            for (int m = 0; m < states[j].qstates.size(); m++){
+                _q_update(states[j].qstates[m], states);
+            }
+            float old_value = states[j].get_value();
+            states[j].update_value();
+            float change = abs(states[j].get_value() - old_value);
+            if (change == 0.0) continue;
+
+            for (int i:local_predecessors[j]){
+                local_pending[i] += discount * change;
+                if (local_pending[i] > error) _queue_local(i);
+            }
+            local_uniform_drift += uniform_weight * change * ((lazy_states && j == 0) ? _unmaterialized_extra() + 1 : 1);
+            if (local_uniform_drift > error){
+                for (int i = 0; i < states.size(); i++)
+                    if (local_untaken[i] > 0) _queue_local(i);
+                local_uniform_drift = 0.0;
+            }
+        }
+    }
+
+    /*
+    Gauss-Seidel value iteration: every sweep reads the values already updated earlier in the same sweep.
+    Stops when no state changes by more than error during a sweep.
+    Returns the memory used, as value_iteration().
+    */
+    int _gauss_seidel_iteration(float error, bool verbose, bool useBounds){
+        int max=0;
+        bool repeat = true;
+        vector<float> V;
+        getStateOnlyValues(V);
+        if (useBounds)
+            update_bounds();
+
+        while(repeat){
+            repeat = false;
+            if (verbose) {
+                printDetails();
+            }
+            for (int j = 0 ; j < states.size(); j++ ){
+                if (_backup_in_place(j, V) > error)
                     repeat = true;
             }
             max=getValue1();
-            V_tmp.clear();
         }
         return max;
     }
+
+    /*
+    Reverse-successor index of the model: for every state, the states whose QStates can lead to it,
+    weighted by discount * probability of the transition. States with a QState never taken depend on every
+    state through the uniform prior; they are listed in uniform_states with weight discount/num_states each.
+    Takes as input the vectors to fill.
+    No output.
+    */
+    void _build_predecessors(vector<int> &offset, vector<int> &predecessor, vector<float> &weight, vector<int> &uniform_states){
+        int num_states = states.size();
+        offset.assign(num_states + 1, 0);
+        uniform_states.clear();
+        TransitionStore &ts = transition_store;
+        for (int i = 0; i < num_states; i++){
+            bool uniform = false;
+            for (auto& qs:states[i].qstates){
+                if (qs.get_num_taken() == 0){
+                    uniform = true;
+                    continue;
+                }
+                for (int k = ts.begin(qs.row); k < ts.end(qs.row); k++)
+                    offset[ts.successors[k] + 1]++;
+            }
+            if (uniform) uniform_states.push_back(i); //once, however many QStates were never taken
+        }
+        for (int i = 0; i < num_states; i++) offset[i+1] += offset[i];
+        predecessor.assign(offset[num_states], 0);
+        weight.assign(offset[num_states], 0.0);
+        vector<int> next(offset.begin(), offset.end() - 1);
+        for (int i = 0; i < num_states; i++){
+            for (auto& qs:states[i].qstates){
+                if (qs.get_num_taken() == 0) continue;
+                for (int k = ts.begin(qs.row); k < ts.end(qs.row); k++){
+                    int pos = next[ts.successors[k]]++;
+                    predecessor[pos] = i;
+                    weight[pos] = discount * ts.probabilities[k];
+                }
+            }
+        }
+    }
+
+    /*
+    Prioritized sweeping: after one in-place sweep, states are backed up in order of the accumulated bound
+    sum(weight * change of successor) on their Bellman residual, taken from a priority queue.
+    Only states whose bound exceeds error are queued, so converged regions of the model are not visited again.
+    Returns the memory used, as value_iteration().
+    */
+    int _prioritized_sweeping(float error, bool useBounds){
+        int num_states = states.size();
+        vector<int> offset, predecessor, uniform_states;
+        vector<float> weight;
+        _build_predecessors(offset, predecessor, weight, uniform_states);
+        if (useBounds)
+            update_bounds();
+
+        vector<float> V;
+        getStateOnlyValues(V);
+        vector<float> priority(num_states, 0.0);
+        priority_queue<pair<float,int>> queue;
+        float uniform_weight = discount / (float)num_potential_states;
+
+        float uniform_drift = 0.0; //bound accumulated by every state in uniform_states, not yet added to their priority
+
+        auto flush_uniform = [&](){
+            for (int i:uniform_states){
+                priority[i] += uniform_drift;
+                if (priority[i] > error) queue.push(make_pair(priority[i], i));
+            }
+            uniform_drift = 0.0;
+        };
+
+        auto propagate = [&](int j, float change){
+            for (int k = offset[j]; k < offset[j+1]; k++){
+                int i = predecessor[k];
+                priority[i] += weight[k] * change;
+                if (priority[i] > error) queue.push(make_pair(priority[i], i));
+            }
+            uniform_drift += uniform_weight * change * ((lazy_states && j == 0) ? _unmaterialized_extra() + 1 : 1);
+            if (uniform_drift > error) flush_uniform();
+        };
+
+        for (int j = 0; j < num_states; j++){
+            priority[j] = 0.0;
+            float change = _backup_in_place(j, V);
+            if (change > 0.0) propagate(j, change);
+        }
+        while (true){
+            if (queue.empty()){
+                if (uniform_drift == 0.0) break;
+                flush_uniform();
+                continue;
+            }
+            pair<float,int> top = queue.top();
+            queue.pop();
+            int j = top.second;
+            if (top.first != priority[j]) continue; //outdated entry, j was queued again or already backed up
+            priority[j] = 0.0;
+            float change = _backup_in_place(j, V);
+            if (change > 0.0) propagate(j, change);
+        }
+        return getValue1();
+    }
+
+    /*
+    Policy improvement step: backs up every QState from V and lets every state pick its best QState,
+    keeping the current one unless another is strictly better so that ties do not make the policy cycle.
+    Takes as input the values of the previous step and the error.
+    Returns (whether any state changed its action, whether any value changed by more than error).
+    */
+    pair<bool,bool> _improve_policy(vector<float> &V, float error){
+        atomic<bool> policy_changed(false);
+        atomic<bool> value_changed(false);
+        sweep_pool.run(states.size(), [&](int first, int last){
+            for (int j = first; j < last; j++){
+                int old_best = states[j].best_qstate;
+                for (int m = 0; m < states[j].qstates.size(); m++){
+                    _q_update2(states[j].qstates[m], V);
+                }
+                states[j].update_value();
+                if (states[j].qstates[old_best].get_qvalue() >= states[j].value)
+                    states[j].best_qstate = old_best;
+                if (states[j].best_qstate != old_best)
+                    policy_changed = true;
+                if (abs(states[j].value - V[j]) > error)
+                    value_changed = true;
+            }
+        });
+        return make_pair((bool)policy_changed, (bool)value_changed);
+    }
+
+    /*
+    Modified policy iteration: one improvement step, then sweeps Jacobi sweeps evaluating only the action of the
+    current policy in every state. Stops when an improvement step changes neither the policy nor any value by more than error.
+    Returns the memory used, as value_iteration().
+    */
+    int _modified_policy_iteration(float error, int sweeps){
+        int max = 0;
+        vector<float> V;
+        getStateOnlyValues(V);
+        while (true){
+            pair<bool,bool> changed = _improve_policy(V, error);
+            V.clear();
+            getStateOnlyValues(V);
+            if (!changed.first && !changed.second)
+                break;
+            for (int i = 0; i < sweeps; i++){
+                sweep_pool.run(states.size(), [&](int first, int last){
+                    for (int j = first; j < last; j++){
+                        QState &qs = states[j].qstates[states[j].best_qstate];
+                        _q_update2(qs, V);
+                        states[j].value = qs.get_qvalue();
+                    }
+                });
+                V.clear();
+                getStateOnlyValues(V);
+            }
+            max = getValue1();
+        }
+        return max;
+    }
+
+    //y = x - discount * P x, P being the transition matrix of the current policy
+    void _policy_matvec(vector<float> &x, vector<float> &y){
+        TransitionStore &ts = transition_store;
+        double total = 0.0;
+        for (int i = 0; i < x.size(); i++) total += x[i];
+        float mean = total / x.size();
+        if (lazy_states)
+            mean = (total + _unmaterialized_extra() * x[0]) / num_potential_states;
+        sweep_pool.run(states.size(), [&](int first, int last){
+            for (int j = first; j < last; j++){
+                QState &qs = states[j].qstates[states[j].best_qstate];
+                float px = 0.0;
+                if (qs.get_num_taken() == 0)
+                    px = mean;
+                else{
+                    for (int k = ts.begin(qs.row); k < ts.end(qs.row); k++)
+                        px += ts.probabilities[k] * x[ts.successors[k]];
+                }
+                y[j] = x[j] - discount * px;
+            }
+        });
+    }
+
+    double _dot(vector<float> &a, vector<float> &b){
+        double d = 0.0;
+        for (int i = 0; i < a.size(); i++) d += (double)a[i] * b[i];
+        return d;
+    }
+
+    /*
+    Solves (I - discount*P) V = R for the current policy with BiCGSTAB, starting from the given V.
+    Stops when the residual norm falls below tolerance or after max_iterations.
+    No output, V holds the solution.
+    */
+    void _evaluate_policy(vector<float> &V, float tolerance, int max_iterations = 1000){
+        int n = states.size();
+        TransitionStore &ts = transition_store;
+        vector<float> b(n, 0.0), r(n), r0(n), p(n, 0.0), v(n, 0.0), s(n), t(n);
+        for (int j = 0; j < n; j++){
+            QState &qs = states[j].qstates[states[j].best_qstate];
+            if (qs.get_num_taken() == 0) continue; //uniform prior, no reward
+            for (int k = ts.begin(qs.row); k < ts.end(qs.row); k++)
+                b[j] += ts.probabilities[k] * ts.mean_rewards[k];
+        }
+        _policy_matvec(V, t);
+        for (int j = 0; j < n; j++){
+            r[j] = b[j] - t[j];
+            r0[j] = r[j];
+        }
+        double rho = 1.0, alpha = 1.0, omega = 1.0;
+        for (int it = 0; it < max_iterations; it++){
+            if (sqrt(_dot(r, r)) <= tolerance) break;
+            double rho_new = _dot(r0, r);
+            if (rho_new == 0.0 || omega == 0.0) break; //breakdown, keep the current V
+            double beta = (rho_new / rho) * (alpha / omega);
+            rho = rho_new;
+            for (int j = 0; j < n; j++) p[j] = r[j] + beta * (p[j] - omega * v[j]);
+            _policy_matvec(p, v);
+            double r0v = _dot(r0, v);
+            if (r0v == 0.0) break;
+            alpha = rho / r0v;
+            for (int j = 0; j < n; j++) s[j] = r[j] - alpha * v[j];
+            if (sqrt(_dot(s, s)) <= tolerance){
+                for (int j = 0; j < n; j++) V[j] += alpha * p[j];
+                break;
+            }
+            _policy_matvec(s, t);
+            double tt = _dot(t, t);
+            omega = (tt == 0.0) ? 0.0 : _dot(t, s) / tt;
+            for (int j = 0; j < n; j++){
+                V[j] += alpha * p[j] + omega * s[j];
+                r[j] = s[j] - omega * t[j];
+            }
+        }
+    }
+
+    /*
+    Policy iteration: every policy is evaluated exactly with _evaluate_policy(), then improved,
+    until the improvement step changes neither the policy nor any value by more than error.
+    Returns the memory used, as value_iteration().
+    */
+    int _policy_iteration(float error, int max_iterations = 1000){
+        int max = 0;
+        vector<float> V;
+        getStateOnlyValues(V);
+        float tolerance = error * (1.0 - discount) * 0.1;
+        for (int i = 0; i < max_iterations; i++){
+            pair<bool,bool> changed = _improve_policy(V, error);
+            V.clear();
+            getStateOnlyValues(V);
+            if (!changed.first && !changed.second)
+                break;
+            _evaluate_policy(V, tolerance);
+            for (int j = 0; j < states.size(); j++){
+                states[j].value = V[j];
+                states[j].qstates[states[j].best_qstate].set_qvalue(V[j]);
+            }
+            max = getValue1();
+        }
+        return max;
+    }
+
     void value_iterationM(int horizon){
         //vector<State> V_tmp;
         vector<float> V_tmp;
@@ -661,23 +1314,425 @@ void _q_update2(QState &qstate, vector<float> &V, int time_step){
             //V_tmp = states;
             //V_tmp = getStateValues1(states, V_tmp);
             getStateOnlyValues(V_tmp);
-            for (int j = 0 ; j < states.size(); j++ ){
-                for (int m = 0; m < states[j].get_qstates().size(); m++){
-                    _q_update2(states[j].qstates[m], V_tmp, i);
+            sweep_pool.run(states.size(), [&](int first, int last){
+                for (int j = first ; j < last; j++ ){
+                    for (int m = 0; m < states[j].qstates.size(); m++){
+                        _q_update2(states[j].qstates[m], V_tmp, i);
+                    }
+                    states[j].update_value();
                 }
-                states[j].update_value();
-            }
+            });
             V_tmp.clear();
         }
     }
 
+    /*
+    Sets the number of threads used by the Bellman sweeps of the model (1 by default, no worker threads).
+    Results do not depend on it.
+    */
+    void set_num_threads(int threads){
+        sweep_pool.set_num_threads(threads);
+    }
+
+    /*
+    Learns the transitions of the model from a trace file of logged trajectories (see TraceFile.h) instead of a
+    live scenario, as update() would for every record, without updating any value: run value_iteration afterwards.
+    The records are split into one chunk per thread of sweep_pool. Every thread maps the measurements of its chunk
+    to states through state_index and accumulates the (state, action, next state) transitions in its own hash table
+    (its shard); the first transition of a chunk, whose previous state belongs to the chunk before, is resolved when
+    the shards are merged in chunk order. The merged transitions are then mapped to QStates in state order
+    (materializing the states in lazy mode) and the store is rebuilt once with add_transitions(). Records with a measurement outside
+    the bins of the model, an action the state does not have or a malformed line are skipped.
+    Takes as input the path of the trace.
+    Returns the number of transitions learned, or -1 if the trace cannot be read or lacks a parameter of the model.
+    */
+    long long ingest_trace(string path){
+        TraceFile trace;
+        if (!trace.open(path)){
+            cerr << "ingest_trace: " << trace.error << endl;
+            return -1;
+        }
+        vector<int> layout; //column of every parameter, in the order of index_params
+        for (auto& name:index_params){
+            int column = find(trace.columns.begin(), trace.columns.end(), name) - trace.columns.begin();
+            if (column == trace.columns.size()){
+                cerr << "ingest_trace: " << path << " has no column " << name << endl;
+                return -1;
+            }
+            layout.push_back(column);
+        }
+        struct Key{
+            int prev;
+            int action;
+            int next;
+            bool operator==(const Key &k) const { return prev == k.prev && action == k.action && next == k.next; }
+            bool operator<(const Key &k) const {
+                return prev < k.prev || (prev == k.prev && (action < k.action || (action == k.action && next < k.next)));
+            }
+        };
+        struct KeyHash{
+            size_t operator()(const Key &k) const { return hash<uint64_t>()(((uint64_t)k.prev * 1000003 + k.action) << 32 ^ (uint32_t)k.next); }
+        };
+        struct Shard{
+            unordered_map<Key, pair<int,double>, KeyHash> transitions = {}; //(state, action, next state) -> count, reward sum
+            bool has_records = false;
+            int first_action = -1;   //first transition of the chunk, from the last state of the chunks before
+            float first_reward = 0.0;
+            int first_state = -1;
+            int last_state = -1;
+            long long skipped = 0;
+        };
+        int num_shards = sweep_pool.num_threads;
+        vector<Shard> shards(num_shards);
+        //states are numbers of the parameter grid here, they only become slots (materialized) when the shards are merged
+        auto learn = [&](Shard &shard, int prev, int action, int next, float reward){
+            if (prev < 0 || next < 0 || action < 0){
+                if (action != -1) shard.skipped++; //-1 starts a trajectory
+                return;
+            }
+            pair<int,double> &t = shard.transitions[{prev, action, next}];
+            t.first++;
+            t.second += reward;
+        };
+        sweep_pool.run(num_shards, [&](int first, int last){
+            vector<double> columns(trace.num_columns());
+            vector<double> values(layout.size());
+            for (int i = first; i < last; i++){
+                Shard &shard = shards[i];
+                size_t pos, end;
+                trace.chunk(i, num_shards, pos, end);
+                int action;
+                float reward;
+                int prev = -1;
+                while (trace.next(pos, end, action, reward, columns.data())){
+                    for (int k = 0; k < layout.size(); k++)
+                        values[k] = columns[layout[k]];
+                    int state = (action == -2) ? -1 : state_index.get_state(values.data());
+                    if (!shard.has_records){
+                        shard.has_records = true;
+                        shard.first_action = action;
+                        shard.first_reward = reward;
+                        shard.first_state = state;
+                    }
+                    else
+                        learn(shard, prev, action, state, reward);
+                    prev = state;
+                }
+                shard.last_state = prev;
+            }
+        });
+
+        int prev = -1;
+        long long learned = 0;
+        long long skipped = 0;
+        vector<pair<Key, pair<int,double>>> merged;
+        for (auto& shard:shards){
+            if (!shard.has_records) continue;
+            learn(shard, prev, shard.first_action, shard.first_state, shard.first_reward);
+            prev = shard.last_state;
+            skipped += shard.skipped;
+            merged.insert(merged.end(), shard.transitions.begin(), shard.transitions.end());
+            unordered_map<Key, pair<int,double>, KeyHash>().swap(shard.transitions);
+        }
+        //shards appended in chunk order, so the sums of a transition seen by several shards are added in chunk order
+        stable_sort(merged.begin(), merged.end(), [](const pair<Key, pair<int,double>> &a, const pair<Key, pair<int,double>> &b){
+            return a.first < b.first;
+        });
+        //in state order, so lazy mode materializes the same slots whatever the number of threads
+        vector<TransitionStore::TransitionCount> added;
+        vector<pair<int,int>> visits; //slot, visits
+        for (int i = 0; i < merged.size(); ){
+            Key key = merged[i].first;
+            int count = 0;
+            double reward_sum = 0.0;
+            for (; i < merged.size() && merged[i].first == key; i++){
+                count += merged[i].second.first;
+                reward_sum += merged[i].second.second;
+            }
+            int from = lazy_states ? _materialize(key.prev) : key.prev;
+            State &s = states[from];
+            int q = 0;
+            while (q < s.qstates.size() && s.qstates[q].action != key.action) q++;
+            if (q == s.qstates.size()){
+                skipped += count;
+                continue;
+            }
+            int row = s.qstates[q].row;
+            int to = lazy_states ? _materialize(key.next) : key.next;
+            added.push_back({row, to, count, reward_sum});
+            visits.push_back(make_pair(from, count));
+            learned += count;
+        }
+        TransitionStore &ts = transition_store;
+        sort(added.begin(), added.end(), [&ts](const TransitionStore::TransitionCount &a, const TransitionStore::TransitionCount &b){
+            return a.row < b.row || (a.row == b.row && ts.key(a.successor) < ts.key(b.successor));
+        });
+        transition_store.add_transitions(added);
+
+        vector<int> taken(transition_store.num_rows(), 0);
+        for (auto& t:added) taken[t.row] += t.count;
+        for (auto& v:visits) states[v.first].num_visited += v.second;
+        for (auto& st:states)
+            for (auto& qs:st.qstates)
+                qs.num_taken += taken[qs.row];
+        if (lazy_states) prev = _materialize(prev);
+        if (prev >= 0)
+            current_state_num = prev;
+        local_predecessors.clear(); //the incremental index is rebuilt by the next update
+        local_work.clear();
+        if (skipped > 0)
+            cerr << "ingest_trace: skipped " << skipped << " records of " << path << endl;
+        return learned;
+    }
+
+    /*
+    Saves the trained model to a snapshot file (see ModelSnapshot.h): parameter bins, action table, the visits,
+    value and best QState of every state (and its number in the grid in lazy mode), the QStates and the sparse transitions and rewards of the store.
+    The store is compacted first. Bounds and incremental bookkeeping are not saved, they are rebuilt when needed.
+    Takes as input the path of the file and a string saved along (the state of the random engine of the caller).
+    Returns false if the file cannot be written.
+    */
+    bool save_snapshot(string path, string rng_state = ""){
+        transition_store.compact();
+        SnapshotWriter w;
+        vector<int> bins;
+        vector<float> limits;
+        for (auto& name:index_params){
+            bins.push_back(parameters[name]["values"].size());
+            for (auto& x:parameters[name]["values"]){
+                limits.push_back(x[0]);
+                limits.push_back(x[1]);
+            }
+        }
+        w.add_strings("param_names", index_params);
+        w.add("param_bins", bins);
+        w.add("param_limits", limits);
+        vector<string> action_names;
+        vector<int> action_values;
+        for (auto& a:actions){
+            action_names.push_back(a.first);
+            action_values.push_back(a.second);
+        }
+        w.add_strings("action_names", action_names);
+        w.add("action_values", action_values);
+        w.add("action_vm_change", action_vm_change);
+        vector<float> scalars = {discount, update_error};
+        vector<int> flags = {initial_state_num, current_state_num, max_VMs, min_VMs, update_algorithm, incremental_update, lazy_states};
+        w.add("scalars", scalars);
+        w.add("flags", flags);
+        if (lazy_states){ //number in the grid of every slot
+            vector<int> ids;
+            for (auto& st:states) ids.push_back(st.state_num);
+            w.add("state_ids", ids);
+        }
+
+        vector<int> visited, best, first_qstate = {0}, q_action, q_taken, q_row;
+        vector<float> values, q_value;
+        for (auto& st:states){
+            visited.push_back(st.num_visited);
+            values.push_back(st.value);
+            best.push_back(st.best_qstate);
+            for (auto& qs:st.qstates){
+                q_action.push_back(qs.action);
+                q_taken.push_back(qs.num_taken);
+                q_value.push_back(qs.qvalue);
+                q_row.push_back(qs.row);
+            }
+            first_qstate.push_back(q_action.size());
+        }
+        w.add("state_visited", visited);
+        w.add("state_value", values);
+        w.add("state_best", best);
+        w.add("state_first_qstate", first_qstate);
+        w.add("qstate_action", q_action);
+        w.add("qstate_taken", q_taken);
+        w.add("qstate_value", q_value);
+        w.add("qstate_row", q_row);
+
+        TransitionStore &ts = transition_store;
+        w.add("row_offset", ts.row_offset);
+        w.add("row_size", ts.row_size);
+        w.add("row_taken", ts.row_taken);
+        w.add("successors", ts.successors);
+        w.add("counts", ts.counts);
+        w.add("reward_sums", ts.reward_sums);
+        w.add("probabilities", ts.probabilities);
+        w.add("mean_rewards", ts.mean_rewards);
+        w.add_strings("rng", {rng_state});
+        return w.write(path);
+    }
+
+    /*
+    Replaces the model with the one of a snapshot file written by save_snapshot. The file is memory-mapped and
+    its arrays copied straight into the model, the states are rebuilt from the saved bins.
+    Takes as input the path of the file and where to put the string saved along (may be NULL).
+    Returns false, leaving the model unchanged, if the file is missing, of another version or inconsistent.
+    */
+    bool load_snapshot(string path, string *rng_state = NULL){
+        SnapshotReader r;
+        vector<string> names, action_names, rng;
+        vector<int> bins, action_values, vm_change, flags, state_ids, visited, best, first_qstate, q_action, q_taken, q_row;
+        vector<float> limits, scalars, values, q_value;
+        TransitionStore ts;
+        bool ok = r.open(path) && r.get_strings("param_names", names) && r.get("param_bins", bins) && r.get("param_limits", limits)
+               && r.get_strings("action_names", action_names) && r.get("action_values", action_values) && r.get("action_vm_change", vm_change)
+               && r.get("scalars", scalars) && r.get("flags", flags) && r.get("state_visited", visited) && r.get("state_value", values)
+               && r.get("state_best", best) && r.get("state_first_qstate", first_qstate) && r.get("qstate_action", q_action)
+               && r.get("qstate_taken", q_taken) && r.get("qstate_value", q_value) && r.get("qstate_row", q_row)
+               && r.get("row_offset", ts.row_offset) && r.get("row_size", ts.row_size) && r.get("row_taken", ts.row_taken)
+               && r.get("successors", ts.successors) && r.get("counts", ts.counts) && r.get("reward_sums", ts.reward_sums)
+               && r.get("probabilities", ts.probabilities) && r.get("mean_rewards", ts.mean_rewards) && r.get_strings("rng", rng);
+        size_t grid_states = 1, num_bins = 0;
+        for (int b:bins){
+            grid_states *= b;
+            num_bins += b;
+        }
+        bool lazy = ok && flags.size() > 6 && flags[6]; //files of before lazy mode have 6 flags
+        if (lazy && !r.get("state_ids", state_ids))
+            ok = false;
+        size_t num_states = lazy ? state_ids.size() : grid_states;
+        int num_qstates = q_action.size();
+        if (ok && (names.size() != bins.size() || limits.size() != 2 * num_bins || action_names.size() != action_values.size()
+                   || scalars.size() < 2 || flags.size() < 6 || visited.size() != num_states || values.size() != num_states
+                   || best.size() != num_states || first_qstate.size() != num_states + 1 || first_qstate[num_states] != num_qstates
+                   || q_taken.size() != num_qstates || q_value.size() != num_qstates || q_row.size() != num_qstates
+                   || ts.row_size.size() != ts.row_offset.size() || ts.row_taken.size() != ts.row_offset.size()
+                   || (lazy && (num_states == 0 || state_ids[0] != -1)))){
+            r.error = "inconsistent sections";
+            ok = false;
+        }
+        if (ok){ //every index read below must point inside its array
+            size_t num_rows = ts.row_offset.size(), num_successors = ts.successors.size();
+            if (ts.counts.size() != num_successors || ts.reward_sums.size() != num_successors
+                || ts.probabilities.size() != num_successors || ts.mean_rewards.size() != num_successors
+                || first_qstate[0] != 0 || flags[0] < 0 || flags[0] >= num_states || flags[1] < 0 || flags[1] >= num_states){
+                r.error = "inconsistent sections";
+                ok = false;
+            }
+            for (size_t i = 0; ok && i < num_states; i++){
+                if (first_qstate[i + 1] < first_qstate[i] || best[i] < 0
+                    || (best[i] >= first_qstate[i + 1] - first_qstate[i] && best[i] > 0)){
+                    r.error = "state " + to_string(i) + " has inconsistent QStates";
+                    ok = false;
+                }
+            }
+            for (int k = 0; ok && k < num_qstates; k++){
+                if (q_row[k] < 0 || q_row[k] >= num_rows || q_action[k] < 0 || q_action[k] >= action_names.size()){
+                    r.error = "QState " + to_string(k) + " has an unknown row or action";
+                    ok = false;
+                }
+            }
+            for (size_t i = 0; ok && i < num_rows; i++){
+                if (ts.row_offset[i] < 0 || ts.row_size[i] < 0 || ts.row_offset[i] > num_successors
+                    || ts.row_size[i] > num_successors - ts.row_offset[i]){
+                    r.error = "row " + to_string(i) + " is out of the successors";
+                    ok = false;
+                }
+            }
+            for (size_t k = 0; ok && k < num_successors; k++){
+                if (ts.successors[k] < 0 || ts.successors[k] >= num_states){
+                    r.error = "successor " + to_string(ts.successors[k]) + " is not a state";
+                    ok = false;
+                }
+            }
+            vector<char> seen(lazy ? grid_states : 0, 0);
+            for (size_t i = 1; ok && i < state_ids.size(); i++){
+                if (state_ids[i] < 0 || state_ids[i] >= grid_states || seen[state_ids[i]]){
+                    r.error = "state id " + to_string(state_ids[i]) + " is out of the grid or repeated";
+                    ok = false;
+                }
+                else
+                    seen[state_ids[i]] = 1;
+            }
+            for (size_t i = 0; ok && i < num_rows; i++){ //successors in grid order (lazy files of before it are in slot order)
+                for (int k = ts.row_offset[i] + 1; ok && k < ts.row_offset[i] + ts.row_size[i]; k++){
+                    int a = ts.successors[k - 1], b = ts.successors[k];
+                    if ((lazy ? state_ids[a] : a) >= (lazy ? state_ids[b] : b)){
+                        r.error = "row " + to_string(i) + " is not sorted";
+                        ok = false;
+                    }
+                }
+            }
+        }
+        if (!ok){
+            cerr << "load_snapshot: " << path << ": " << r.error << endl;
+            return false;
+        }
+
+        states = vector<State>(1);
+        index_params.clear();
+        state_index = StateIndex();
+        parameters = json({});
+        lazy_states = lazy;
+        int l = 0;
+        for (int i = 0; i < names.size(); i++){
+            json bin_limits = json::array();
+            for (int b = 0; b < bins[i]; b++, l += 2)
+                bin_limits.push_back({limits[l], limits[l + 1]});
+            parameters[names[i]]["values"] = bin_limits;
+            index_params.push_back(names[i]);
+            state_index.add_parameter(names[i], bin_limits);
+        }
+        num_potential_states = grid_states;
+        state_slots.clear();
+        if (!lazy)
+            _build_states();
+        else{
+            states.clear();
+            states.push_back(State(&state_index, -1, 0.0, grid_states));
+            for (int i = 1; i < state_ids.size(); i++){
+                states.push_back(State(&state_index, state_ids[i]));
+                state_slots[state_ids[i]] = i;
+            }
+        }
+        actions.clear();
+        for (int i = 0; i < action_names.size(); i++)
+            actions.push_back(make_pair(action_names[i], action_values[i]));
+        action_vm_change = vm_change;
+        discount = scalars[0];
+        update_error = scalars[1];
+        initial_state_num = flags[0];
+        current_state_num = flags[1];
+        max_VMs = flags[2];
+        min_VMs = flags[3];
+        update_algorithm = flags[4];
+        incremental_update = flags[5];
+
+        ts.row_capacity = ts.row_size;
+        transition_store = ts;
+        if (lazy)
+            transition_store.successor_keys = state_ids;
+        for (int i = 0; i < states.size(); i++){
+            State &st = states[i];
+            st.set_num_states(grid_states);
+            st.qstates.clear();
+            st.qstates.reserve(first_qstate[i + 1] - first_qstate[i]);
+            for (int k = first_qstate[i]; k < first_qstate[i + 1]; k++){
+                QState q(q_action[k], grid_states, q_value[k]);
+                q.store = &transition_store;
+                q.row = q_row[k];
+                q.num_taken = q_taken[k];
+                st.qstates.push_back(q);
+            }
+            st.num_visited = visited[i];
+            st.value = values[i];
+            st.best_qstate = best[i];
+            st.isBestQStateSet = true;
+        }
+        local_predecessors.clear();
+        local_work.clear();
+        if (rng_state != NULL)
+            *rng_state = rng.empty() ? "" : rng[0];
+        return true;
+    }
+
     void getStateOnlyValues(vector<float> &V){
         for (int i=0; i < states.size(); i++){
             V.push_back(states[i].get_value());
         }
     }
 
-    vector<string> get_parameters(){
+    const vector<string>& get_parameters() const{
         return index_params;
     }
     
@@ -697,7 +1752,7 @@ void _q_update2(QState &qstate, vector<float> &V, int time_step){
     void print_model(bool detailed=false){
         for (auto& s:states){
             if (detailed){
-                s.print_detailed();
+                s.print_detailed(actions);
                 cout << endl;
             }
             else
@@ -705,6 +1760,28 @@ void _q_update2(QState &qstate, vector<float> &V, int time_step){
         }
     }
 
+    /*
+    Precomputes QState::reward_correction for every QState and every phase of the time-varying reward
+    (time_step % number of successors), so that finite-horizon sweeps read one table entry per QState
+    instead of searching the successors and dividing. The table is dropped by the next transition recorded.
+    Takes as input the reward factor of the time-varying reward.
+    No output.
+    */
+    void build_reward_tables(float reward_factor = 0.8){
+        TransitionStore &ts = transition_store;
+        vector<float> table(ts.successors.size(), 0.0);
+        ts.reward_corrections.clear();
+        for (auto& s:states){
+            for (auto& qs:s.qstates){
+                int size = ts.size(qs.row);
+                for (int phase = 0; phase < size; phase++)
+                    table[ts.begin(qs.row) + phase] = qs.reward_correction(phase, reward_factor);
+            }
+        }
+        ts.reward_corrections.swap(table);
+        ts.reward_table_factor = reward_factor;
+    }
+
     void update_bounds(){
         float t = 0.0;
         float curr_max = -INFINITY;
@@ -713,17 +1790,32 @@ void _q_update2(QState &qstate, vector<float> &V, int time_step){
         for (auto& s:states){
             s.max_lower_bound = -INFINITY;
             for (auto& qs:s.qstates){//for every QState calculate upper and lower bounds of Q(s,a)
-                for (int i=0; i < states.size(); i++){
-                    t = qs.get_transition(i);
-                    if (t != 0.0){//calculate max/min of V(s') accessible from current state s
+                float max_reward = 0.0;
+                float min_reward = 0.0;
+                if (qs.get_num_taken() == 0){//never taken, every state is accessible
+                    for (int i=0; i < states.size(); i++){
                         curr_max = max(curr_max, states[i].get_value());
                         curr_min = min(curr_min, states[i].get_value());
                         f = true;
                     }
                 }
+                else{
+                    TransitionStore &ts = *qs.store;
+                    if (ts.size(qs.row) == states.size()){//every state accessible, no zero rewards to account for
+                        max_reward = -INFINITY;
+                        min_reward = INFINITY;
+                    }
+                    for (int k = ts.begin(qs.row); k < ts.end(qs.row); k++){//calculate max/min of V(s') accessible from current state s
+                        curr_max = max(curr_max, states[ts.successors[k]].get_value());
+                        curr_min = min(curr_min, states[ts.successors[k]].get_value());
+                        f = true;
+                        max_reward = max(max_reward, ts.reward_sums[k]);
+                        min_reward = min(min_reward, ts.reward_sums[k]);
+                    }
+                }
                 if (f){//if the state is not terminal, calculate max/min of rewards and add to the values calculated above to get bounds
-                qs.upper_bound = *max_element(qs.rewards.begin(), qs.rewards.end()) + discount * curr_max;
-                qs.lower_bound = *min_element(qs.rewards.begin(), qs.rewards.end()) + discount * curr_min;
+                qs.upper_bound = max_reward + discount * curr_max;
+                qs.lower_bound = min_reward + discount * curr_min;
                 }
                 else{//if the state is terminal, set upper bound to highest posssible and lower bound to lowest possible
                     qs.upper_bound = INFINITY;
@@ -741,19 +1833,18 @@ void _q_update2(QState &qstate, vector<float> &V, int time_step){
     void printDetails(){
         for (int i=0; i<states.size(); i++){
                 cout << "State " << states[i].get_state_num()<< ": " << endl;
-                for (int j=0; j<states[i].get_qstates().size(); j++){
-                    cout << "\tQstate " << states[i].qstates[j].action.first <<": " << endl;
-                    for (int k=0; k< states[i].qstates[j].transitions.size(); k++){
-                        if(states[i].qstates[j].get_transition(k) > 0){
-                        cout << "\tTransition to " << k << " :" << states[i].qstates[j].get_transition(k) << ", Reward: " << states[i].qstates[j].get_reward(k) << endl;
-                        }
-
+                for (int j=0; j<states[i].qstates.size(); j++){
+                    cout << "\tQstate " << actions[states[i].qstates[j].action].first <<": " << endl;
+                    TransitionStore &ts = *states[i].qstates[j].store;
+                    for (int k=ts.begin(states[i].qstates[j].row); k < ts.end(states[i].qstates[j].row); k++){
+                        int next = ts.successors[k];
+                        cout << "\tTransition to " << next << " :" << states[i].qstates[j].get_transition(next) << ", Reward: " << states[i].qstates[j].get_reward(next) << endl;
                     }
                 }
         }
     }
 
-    vector<pair<int,float>> getStateValues(vector<State> V){
+    vector<pair<int,float>> getStateValues(const vector<State> &V){
         vector<pair<int,float>> values;
         //values.reserve(V.size());    
 
@@ -765,7 +1856,7 @@ void _q_update2(QState &qstate, vector<float> &V, int time_step){
     }
 
 
-        vector<pair<int,float>> getStateValues1(vector<State> V,vector<pair<int,float>> values){
+        vector<pair<int,float>> getStateValues1(const vector<State> &V,vector<pair<int,float>> values){
 
         for (int i=0; i < V.size(); i++){
             values.push_back(make_pair( V[i].get_best_qstate(), V[i].get_value()));
@@ -774,7 +1865,7 @@ void _q_update2(QState &qstate, vector<float> &V, int time_step){
         return values;
     }
 
-    vector<pair<int,float>> getStateValuestest(vector<State>& V){
+    vector<pair<int,float>> getStateValuestest(const vector<State>& V){
         vector<pair<int,float>> values;
         //values.reserve(V.size());    
         for (int i=0; i < V.size(); i++){
@@ -784,7 +1875,7 @@ void _q_update2(QState &qstate, vector<float> &V, int time_step){
         return values;
     }
 
-    void loadValueFunction(vector<pair<int, float>> V){
+    void loadValueFunction(const vector<pair<int, float>> &V){
         for (int i=0; i < V.size(); i++){
             states[i].best_qstate = V[i].first;
             states[i].value = V[i].second;
@@ -808,3 +1899,4 @@ void _q_update2(QState &qstate, vector<float> &V, int time_step){
     }
         
 };
+#endif
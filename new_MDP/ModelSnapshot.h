@@ -0,0 +1,232 @@
+#ifndef MODELSNAPSHOT_H
+#define MODELSNAPSHOT_H
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef linux
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/*
+Binary snapshot file of a trained model, written by MDPModel::save_snapshot and read by MDPModel::load_snapshot.
+Layout (native byte order, little endian on every platform the experiments run on):
+    header   "MDPSNAP" magic (8 bytes), format version, number of sections (uint32 each)
+    table    one SnapshotSection per section: name, element size, byte offset and number of elements
+    data     the arrays of the sections, every one starting on a 64 byte boundary
+The reader maps the file (or reads it where mmap is not available) and hands out pointers into it;
+MDPModel::load_snapshot copies every section it needs into the model. Sections are looked up by name and
+the ones a reader does not know are skipped, so adding a section keeps the version; the version changes
+when the layout of an existing section changes, and files of another version are rejected.
+*/
+const char SNAPSHOT_MAGIC[8] = {'M', 'D', 'P', 'S', 'N', 'A', 'P', '\0'};
+const uint32_t SNAPSHOT_VERSION = 1;
+
+struct SnapshotSection{
+    char name[24];
+    uint32_t element_size;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t count;
+};
+
+class SnapshotWriter{
+public:
+    vector<SnapshotSection> sections = {};
+    vector<vector<char>> data = {};
+
+    //adds a section holding a copy of count elements of type T
+    template <typename T>
+    void add(string name, const T* elements, size_t count){
+        SnapshotSection s;
+        memset(&s, 0, sizeof(s));
+        strncpy(s.name, name.c_str(), sizeof(s.name) - 1);
+        s.element_size = sizeof(T);
+        s.count = count;
+        sections.push_back(s);
+        data.push_back(vector<char>((const char*)elements, (const char*)elements + count * sizeof(T)));
+    }
+
+    template <typename T>
+    void add(string name, const vector<T> &elements){
+        add(name, elements.data(), elements.size());
+    }
+
+    //strings are kept one after the other, each one followed by a 0
+    void add_strings(string name, const vector<string> &strings){
+        vector<char> chars;
+        for (auto& s:strings){
+            chars.insert(chars.end(), s.begin(), s.end());
+            chars.push_back('\0');
+        }
+        add(name, chars);
+    }
+
+    /*
+    Writes the header, the section table and the sections to a file.
+    Returns false if the file cannot be written.
+    */
+    bool write(string path){
+        uint64_t offset = _align(16 + sections.size() * sizeof(SnapshotSection));
+        for (int i = 0; i < sections.size(); i++){
+            sections[i].offset = offset;
+            offset = _align(offset + data[i].size());
+        }
+        ofstream out(path, ios::binary | ios::trunc);
+        if (!out) return false;
+        uint32_t counts[2] = {SNAPSHOT_VERSION, (uint32_t)sections.size()};
+        out.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+        out.write((const char*)counts, sizeof(counts));
+        out.write((const char*)sections.data(), sections.size() * sizeof(SnapshotSection));
+        uint64_t position = 16 + sections.size() * sizeof(SnapshotSection);
+        vector<char> padding(64, 0);
+        for (int i = 0; i < sections.size(); i++){
+            out.write(padding.data(), sections[i].offset - position);
+            out.write(data[i].data(), data[i].size());
+            position = sections[i].offset + data[i].size();
+        }
+        return (bool)out;
+    }
+
+    uint64_t _align(uint64_t offset){
+        return (offset + 63) / 64 * 64;
+    }
+};
+
+class SnapshotReader{
+public:
+    const char* mapped = NULL;
+    size_t file_size = 0;
+    int fd = -1;
+    vector<char> buffer = {};   //contents of the file where mmap is not available
+    const SnapshotSection* table = NULL;
+    uint32_t num_sections = 0;
+    string error = "";
+
+    SnapshotReader(){}
+
+    SnapshotReader(const SnapshotReader&) = delete;
+    SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+    ~SnapshotReader(){
+        _close();
+    }
+
+    /*
+    Maps a snapshot file and checks its header and section table.
+    Returns false, with a message in error, if the file is missing, truncated or of another version.
+    */
+    bool open(string path){
+        _close();
+#ifdef linux
+        fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0){
+            error = "cannot open " + path;
+            return false;
+        }
+        file_size = st.st_size;
+        if (file_size > 0){
+            void* p = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED){
+                mapped = (const char*)p;
+                madvise(p, file_size, MADV_WILLNEED);
+            }
+        }
+#endif
+        if (mapped == NULL){
+            ifstream in(path, ios::binary);
+            if (!in){
+                error = "cannot open " + path;
+                return false;
+            }
+            buffer.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+            file_size = buffer.size();
+            mapped = buffer.data();
+        }
+        uint32_t version = 0;
+        if (file_size < 16 || memcmp(mapped, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0){
+            error = path + " is not a model snapshot";
+            return false;
+        }
+        memcpy(&version, mapped + 8, sizeof(version));
+        memcpy(&num_sections, mapped + 12, sizeof(num_sections));
+        if (version != SNAPSHOT_VERSION){
+            error = path + " has snapshot version " + to_string(version) + ", expected " + to_string(SNAPSHOT_VERSION);
+            return false;
+        }
+        table = (const SnapshotSection*)(mapped + 16);
+        if (16 + (uint64_t)num_sections * sizeof(SnapshotSection) > file_size){
+            error = path + " is truncated";
+            return false;
+        }
+        for (int i = 0; i < num_sections; i++){
+            if (table[i].offset > file_size || (table[i].element_size > 0
+                && table[i].count > (file_size - table[i].offset) / table[i].element_size)){ //no overflow on corrupt counts
+                error = path + " is truncated";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /*
+    Finds a section by name.
+    Takes as input the name and the place for its number of elements.
+    Returns a pointer to its elements inside the mapping, or NULL (setting error) if it is missing or holds another type.
+    */
+    template <typename T>
+    const T* get(string name, size_t &count){
+        for (int i = 0; i < num_sections; i++){
+            if (strncmp(table[i].name, name.c_str(), sizeof(table[i].name)) == 0){
+                if (table[i].element_size != sizeof(T)) break;
+                count = table[i].count;
+                return (const T*)(mapped + table[i].offset);
+            }
+        }
+        error = "missing section " + name;
+        count = 0;
+        return NULL;
+    }
+
+    //copies a section into a vector, returns false if it is missing
+    template <typename T>
+    bool get(string name, vector<T> &elements){
+        size_t count;
+        const T* p = get<T>(name, count);
+        if (p == NULL) return false;
+        elements.assign(p, p + count);
+        return true;
+    }
+
+    bool get_strings(string name, vector<string> &strings){
+        size_t count;
+        const char* p = get<char>(name, count);
+        if (p == NULL) return false;
+        strings.clear();
+        for (size_t i = 0; i < count; i += strings.back().size() + 1)
+            strings.push_back(string(p + i, strnlen(p + i, count - i)));
+        return true;
+    }
+
+    void _close(){
+#ifdef linux
+        if (mapped != NULL && buffer.empty()) munmap((void*)mapped, file_size);
+        if (fd >= 0) ::close(fd);
+#endif
+        mapped = NULL;
+        fd = -1;
+        buffer.clear();
+        table = NULL;
+        num_sections = 0;
+    }
+};
+#endif
@@ -0,0 +1,49 @@
+#ifndef ROLLOUTSTATS_H
+#define ROLLOUTSTATS_H
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+
+/*
+Summary of the total rewards collected by independent rollouts of a policy: sample mean and variance,
+standard error of the mean and the normal confidence interval mean +- z * std_error (z = 1.96 gives 95%).
+The sums are taken in double and in rollout order, so the summary does not depend on how the rollouts were
+split between threads.
+*/
+class RolloutStats{
+public:
+    int num_rollouts = 0;
+    double mean = 0.0;
+    double variance = 0.0;   //unbiased sample variance, 0 with fewer than two rollouts
+    double std_error = 0.0;
+    double ci_low = 0.0;
+    double ci_high = 0.0;
+    float min_reward = 0.0;
+    float max_reward = 0.0;
+    float z = 1.96;
+
+    RolloutStats(){}
+
+    /*
+    Takes as input the total reward of every rollout and the z value of the confidence interval.
+    */
+    RolloutStats(const vector<float> &rewards, float z_value = 1.96){
+        z = z_value;
+        num_rollouts = rewards.size();
+        if (num_rollouts == 0) return;
+        double sum = 0.0;
+        for (float r:rewards) sum += r;
+        mean = sum / num_rollouts;
+        double squares = 0.0; //two passes, the rewards of long horizons are large and close to each other
+        for (float r:rewards) squares += (r - mean) * (r - mean);
+        if (num_rollouts > 1) variance = squares / (num_rollouts - 1);
+        std_error = sqrt(variance / num_rollouts);
+        ci_low = mean - z * std_error;
+        ci_high = mean + z * std_error;
+        min_reward = *min_element(rewards.begin(), rewards.end());
+        max_reward = *max_element(rewards.begin(), rewards.end());
+    }
+};
+#endif
@@ -0,0 +1,137 @@
+#ifndef STATEINDEX_H
+#define STATEINDEX_H
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <nlohmann\json.hpp>
+#endif
+
+#ifdef linux
+#include <nlohmann/json.hpp>
+#endif
+
+using json = nlohmann::json;
+
+using namespace std;
+
+/*
+Maps a vector of measurements to the number of the state containing it, without scanning the states.
+Parameters are added in the same order MDPModel::_update_states() combines them, so the state number is
+the mixed-radix number sum(bin_of_parameter * stride_of_parameter), the first parameter being the least significant.
+Every parameter keeps its bins sorted by upper limit; a measurement falls in the first bin whose upper limit
+is not below it (the same bin the old linear scan picked when a value lies on the limit of two bins).
+It is also the parameter schema of the model: names and bin limits are held here once, and the bins of a state
+are the digits of its number (bin_of, limits_of), so states keep no copy of them.
+*/
+class StateIndex{
+public:
+    struct ParameterBins{
+        string name;
+        int stride;
+        vector<float> lower;   //lower limit of every bin, sorted by upper limit
+        vector<float> upper;   //upper limit of every bin, ascending
+        vector<int> bin;       //index of every bin in the configuration order
+        vector<pair<float,float>> limits; //limits of every bin, in the configuration order
+    };
+
+    vector<ParameterBins> params = {};
+    int num_states = 1;
+
+    /*
+    Adds a new parameter as the most significant digit of the state number.
+    Takes as input the name of the parameter and its "values" as built by MDPModel::_get_params (pairs of limits).
+    No output.
+    */
+    void add_parameter(string name, json values){
+        ParameterBins p;
+        p.name = name;
+        p.stride = num_states;
+        vector<pair<pair<float,float>,int>> bins;
+        int i = 0;
+        for (auto& x:values){
+            float lo = x[0];
+            float hi = x[1];
+            bins.push_back(make_pair(make_pair(hi, lo), i));
+            p.limits.push_back(make_pair(lo, hi));
+            i++;
+        }
+        sort(bins.begin(), bins.end());
+        for (auto& b:bins){
+            p.upper.push_back(b.first.first);
+            p.lower.push_back(b.first.second);
+            p.bin.push_back(b.second);
+        }
+        num_states = num_states * bins.size();
+        params.push_back(p);
+    }
+
+    /*
+    Finds the bin of a single parameter that contains the given value, O(log B).
+    The value is compared in double precision against the float limits, as the measurements are doubles.
+    Returns the bin index in configuration order, or -1 if the value lies outside every bin.
+    */
+    int get_bin(int param, double value){
+        ParameterBins &p = params[param];
+        int pos = lower_bound(p.upper.begin(), p.upper.end(), value) - p.upper.begin();
+        if (pos == p.upper.size() || value < p.lower[pos])
+            return -1;
+        return p.bin[pos];
+    }
+
+    /*
+    Finds the number of the state that contains the given measurements.
+    Returns -1 if a measurement lies outside the bins of its parameter.
+    */
+    int get_state(const json &measurements){
+        int state_num = 0;
+        for (int i = 0; i < params.size(); i++){
+            int b = get_bin(i, measurements[params[i].name]);
+            if (b < 0) return -1;
+            state_num += b * params[i].stride;
+        }
+        return state_num;
+    }
+
+    /*
+    Same as above, for measurements already laid out in the order of the parameters (values[i] belongs to params[i]).
+    No allocation and no string lookups, meant for training loops.
+    */
+    int get_state(const double* values){
+        int state_num = 0;
+        for (int i = 0; i < params.size(); i++){
+            int b = get_bin(i, values[i]);
+            if (b < 0) return -1;
+            state_num += b * params[i].stride;
+        }
+        return state_num;
+    }
+
+    //index of a parameter in params, -1 if the model has no such parameter
+    int find_parameter(const string &name) const{
+        for (int i = 0; i < params.size(); i++)
+            if (params[i].name == name) return i;
+        return -1;
+    }
+
+    //bin of a parameter (in configuration order) in a state: the digit of the state number
+    int bin_of(int state_num, int param) const{
+        return (state_num / params[param].stride) % (int)params[param].limits.size();
+    }
+
+    pair<float,float> limits_of(int state_num, int param) const{
+        return params[param].limits[bin_of(state_num, param)];
+    }
+
+    /*
+    Lays out json measurements in the order of the parameters, as expected by get_state(const double*).
+    Takes as input the measurements and an array of params.size() values.
+    No output.
+    */
+    void get_values(const json &measurements, double* values){
+        for (int i = 0; i < params.size(); i++)
+            values[i] = measurements[params[i].name];
+    }
+};
+#endif
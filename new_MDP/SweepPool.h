@@ -0,0 +1,110 @@
+#ifndef SWEEPPOOL_H
+#define SWEEPPOOL_H
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+
+using namespace std;
+
+/*
+Persistent worker threads used to split a Bellman sweep over the states of a model.
+run(n, f) calls f(first, last) on num_threads contiguous, equally sized chunks of [0, n), the calling
+thread taking the first chunk, and returns when every chunk is done. Every state is backed up by exactly
+one thread from a frozen value vector, so results do not depend on the number of threads.
+With a single thread (the default) f(0, n) is called directly.
+*/
+class SweepPool{
+public:
+    int num_threads = 1;
+    vector<thread> workers = {};
+    mutex lock;
+    condition_variable start_cv;
+    condition_variable done_cv;
+    const function<void(int,int)>* job = NULL;
+    int job_size = 0;
+    int generation = 0;  //increased for every job, wakes up the workers
+    int pending = 0;     //workers still running the current job
+    bool stopping = false;
+
+    SweepPool(){}
+
+    SweepPool(const SweepPool&) = delete;
+    SweepPool& operator=(const SweepPool&) = delete;
+
+    ~SweepPool(){
+        _stop_workers();
+    }
+
+    /*
+    Sets the number of threads used by run(), including the calling thread.
+    Takes as input the number of threads, values below 1 are treated as 1.
+    No output.
+    */
+    void set_num_threads(int threads){
+        _stop_workers();
+        num_threads = max(1, threads);
+        for (int i = 1; i < num_threads; i++)
+            workers.push_back(thread(&SweepPool::_work, this, i));
+    }
+
+    void run(int n, const function<void(int,int)> &f){
+        if (num_threads == 1 || n < num_threads){
+            f(0, n);
+            return;
+        }
+        {
+            unique_lock<mutex> guard(lock);
+            job = &f;
+            job_size = n;
+            pending = num_threads - 1;
+            generation++;
+        }
+        start_cv.notify_all();
+        f(0, _chunk_end(n, 0));
+        unique_lock<mutex> guard(lock);
+        done_cv.wait(guard, [this]{ return pending == 0; });
+        job = NULL;
+    }
+
+    int _chunk_end(int n, int chunk){
+        return (int)((long long)n * (chunk + 1) / num_threads);
+    }
+
+    void _work(int chunk){
+        int seen = 0;
+        while (true){
+            const function<void(int,int)>* f;
+            int n;
+            {
+                unique_lock<mutex> guard(lock);
+                start_cv.wait(guard, [this, seen]{ return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                f = job;
+                n = job_size;
+            }
+            (*f)(_chunk_end(n, chunk - 1), _chunk_end(n, chunk));
+            {
+                unique_lock<mutex> guard(lock);
+                pending--;
+                if (pending == 0) done_cv.notify_one();
+            }
+        }
+    }
+
+    void _stop_workers(){
+        {
+            unique_lock<mutex> guard(lock);
+            stopping = true;
+        }
+        start_cv.notify_all();
+        for (auto& w:workers) w.join();
+        workers.clear();
+        stopping = false;
+        generation = 0;
+    }
+};
+#endif
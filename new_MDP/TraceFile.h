@@ -0,0 +1,305 @@
+#ifndef TRACEFILE_H
+#define TRACEFILE_H
+#include <vector>
+#include <string>
+#include <fstream>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef linux
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/*
+Logged trajectories of (measurements, action, reward) records, read by MDPModel::ingest_trace.
+Record k holds the measurements observed after taking its action from the state of record k-1 and the reward
+collected by that transition; a record with action -1 starts a new trajectory (its reward is ignored).
+Two encodings are read:
+    CSV     a header line naming the columns, which must include "action" and "reward", then one record per line
+            (the action is its id in MDPModel::actions, the other columns are measurements matched by name)
+    binary  "MDPTRACE" magic (8 bytes), format version and number of measurement columns (uint32 each), the
+            column names each followed by a 0 and padded with 0s to a multiple of 8 bytes, then fixed size
+            records: action (int32), reward (float) and the measurements (double each)
+The file is memory-mapped and read sequentially, so traces larger than memory are only paged in as they are
+consumed. chunk() splits the records into contiguous byte ranges that threads can parse independently.
+*/
+const char TRACE_MAGIC[8] = {'M', 'D', 'P', 'T', 'R', 'A', 'C', 'E'};
+const uint32_t TRACE_VERSION = 1;
+
+class TraceWriter{
+public:
+    ofstream out;
+    bool binary = true;
+    int num_columns = 0;
+
+    /*
+    Creates a trace file with the given measurement columns, in CSV if the path ends with .csv and in binary otherwise.
+    Returns false if the file cannot be created.
+    */
+    bool open(string path, const vector<string> &names){
+        binary = !(path.size() >= 4 && path.substr(path.size() - 4) == ".csv");
+        num_columns = names.size();
+        out.open(path, ios::binary | ios::trunc);
+        if (!out) return false;
+        if (!binary){
+            for (auto& name:names) out << name << ",";
+            out << "action,reward\n";
+            out.precision(17);
+            return (bool)out;
+        }
+        uint32_t header[2] = {TRACE_VERSION, (uint32_t)num_columns};
+        out.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+        out.write((const char*)header, sizeof(header));
+        size_t bytes = 0;
+        for (auto& name:names){
+            out.write(name.c_str(), name.size() + 1);
+            bytes += name.size() + 1;
+        }
+        vector<char> padding((8 - bytes % 8) % 8, 0);
+        out.write(padding.data(), padding.size());
+        return (bool)out;
+    }
+
+    void write(int action, float reward, const double* values){
+        if (!binary){
+            for (int i = 0; i < num_columns; i++) out << values[i] << ",";
+            out << action << "," << reward << "\n";
+            return;
+        }
+        int32_t a = action;
+        out.write((const char*)&a, sizeof(a));
+        out.write((const char*)&reward, sizeof(reward));
+        out.write((const char*)values, num_columns * sizeof(double));
+    }
+
+    bool close(){
+        out.close();
+        return !out.fail();
+    }
+};
+
+class TraceFile{
+public:
+    const char* data = NULL;
+    size_t file_size = 0;
+    int fd = -1;
+    vector<char> buffer = {};     //contents of the file where mmap is not available
+    bool binary = false;
+    vector<string> columns = {};  //measurement columns, in file order
+    size_t data_begin = 0;        //offset of the first record
+    size_t record_size = 0;       //binary: bytes of a record
+    int action_column = -1;       //CSV: fields holding the action and the reward
+    int reward_column = -1;
+    int num_fields = 0;           //CSV: fields of a line
+    vector<int> field_column = {};//CSV: measurement column of every field, -1 for the action, the reward and unknown fields
+    string error = "";
+
+    TraceFile(){}
+
+    TraceFile(const TraceFile&) = delete;
+    TraceFile& operator=(const TraceFile&) = delete;
+
+    ~TraceFile(){
+        _close();
+    }
+
+    /*
+    Maps a trace file and reads its header.
+    Returns false, with a message in error, if the file is missing or its header is invalid.
+    */
+    bool open(string path){
+        _close();
+#ifdef linux
+        fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0){
+            error = "cannot open " + path;
+            return false;
+        }
+        file_size = st.st_size;
+        if (file_size > 0){
+            void* p = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED){
+                data = (const char*)p;
+                madvise(p, file_size, MADV_SEQUENTIAL);
+            }
+        }
+#endif
+        if (data == NULL){
+            ifstream in(path, ios::binary);
+            if (!in){
+                error = "cannot open " + path;
+                return false;
+            }
+            buffer.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+            file_size = buffer.size();
+            data = buffer.data();
+        }
+        binary = file_size >= 8 && memcmp(data, TRACE_MAGIC, sizeof(TRACE_MAGIC)) == 0;
+        if (binary ? !_read_binary_header() : !_read_csv_header()){
+            error = path + ": " + error;
+            return false;
+        }
+        return true;
+    }
+
+    int num_columns(){
+        return columns.size();
+    }
+
+    /*
+    Splits the records into n contiguous byte ranges of about the same size, ending on record boundaries.
+    Takes as input the chunk and the number of chunks.
+    Returns the range [first, last) of the chunk through first and last, possibly empty.
+    */
+    void chunk(int i, int n, size_t &first, size_t &last){
+        first = _boundary(data_begin + (file_size - data_begin) * i / n);
+        last = _boundary(data_begin + (file_size - data_begin) * (i + 1) / n);
+    }
+
+    /*
+    Parses the record starting at pos and moves pos to the next one.
+    Takes as input the position, the end of the range, and where to put the action, the reward and the
+    measurements (num_columns() values, in column order).
+    Returns false when no record is left before last. A malformed CSV line gives action -2.
+    */
+    bool next(size_t &pos, size_t last, int &action, float &reward, double* values){
+        if (binary){
+            if (pos + record_size > last) return false;
+            int32_t a;
+            memcpy(&a, data + pos, sizeof(a));
+            memcpy(&reward, data + pos + 4, sizeof(reward));
+            memcpy(values, data + pos + 8, columns.size() * sizeof(double));
+            action = a;
+            pos += record_size;
+            return true;
+        }
+        while (pos < last && (data[pos] == '\n' || data[pos] == '\r')) pos++; //empty lines
+        if (pos >= last) return false;
+        const char* p = data + pos;
+        const char* end = (const char*)memchr(p, '\n', last - pos);
+        if (end == NULL) end = data + last;
+        pos = end - data + 1;
+        action = -2;
+        int field = 0;
+        bool has_action = false, has_reward = false;
+        char text[64];
+        while (p <= end && field < num_fields){
+            const char* q = p;
+            while (q < end && *q != ',') q++;
+            size_t len = q - p;
+            while (len > 0 && (p[len - 1] == '\r' || p[len - 1] == ' ')) len--;
+            if (len >= sizeof(text)) return true;
+            memcpy(text, p, len);
+            text[len] = '\0';
+            char* parsed;
+            if (field == action_column){
+                action = strtol(text, &parsed, 10);
+                has_action = parsed != text;
+            }
+            else if (field == reward_column){
+                reward = strtof(text, &parsed);
+                has_reward = parsed != text;
+            }
+            else if (field_column[field] >= 0){
+                values[field_column[field]] = strtod(text, &parsed);
+                if (parsed == text){
+                    action = -2;
+                    return true;
+                }
+            }
+            field++;
+            p = q + 1;
+        }
+        if (field < num_fields || !has_action || !has_reward)
+            action = -2;
+        return true;
+    }
+
+    bool _read_binary_header(){
+        if (file_size < 16){
+            error = "truncated header";
+            return false;
+        }
+        uint32_t header[2];
+        memcpy(header, data + 8, sizeof(header));
+        if (header[0] != TRACE_VERSION){
+            error = "trace version " + to_string(header[0]) + ", expected " + to_string(TRACE_VERSION);
+            return false;
+        }
+        size_t pos = 16;
+        for (uint32_t i = 0; i < header[1]; i++){
+            const char* end = (const char*)memchr(data + pos, '\0', file_size - pos);
+            if (end == NULL){
+                error = "truncated header";
+                return false;
+            }
+            columns.push_back(string(data + pos, end));
+            pos = end - data + 1;
+        }
+        data_begin = 16 + (pos - 16 + 7) / 8 * 8;
+        record_size = 8 + columns.size() * sizeof(double);
+        if (data_begin > file_size){
+            error = "truncated header";
+            return false;
+        }
+        return true;
+    }
+
+    bool _read_csv_header(){
+        const char* end = (const char*)memchr(data, '\n', file_size);
+        if (end == NULL) end = data + file_size;
+        data_begin = min(file_size, (size_t)(end - data) + 1);
+        const char* p = data;
+        while (p <= end && p < data + file_size){
+            const char* q = p;
+            while (q < end && *q != ',') q++;
+            string name(p, q);
+            while (!name.empty() && (name.back() == '\r' || name.back() == ' ')) name.pop_back();
+            if (name == "action") action_column = num_fields;
+            else if (name == "reward") reward_column = num_fields;
+            field_column.push_back((name == "action" || name == "reward") ? -1 : columns.size());
+            if (name != "action" && name != "reward") columns.push_back(name);
+            num_fields++;
+            p = q + 1;
+        }
+        if (action_column < 0 || reward_column < 0){
+            error = "the header has no action or reward column";
+            return false;
+        }
+        return true;
+    }
+
+    //first record boundary at or after offset
+    size_t _boundary(size_t offset){
+        if (offset <= data_begin) return data_begin;
+        if (offset >= file_size) return file_size;
+        if (binary)
+            return min(file_size, data_begin + (offset - data_begin + record_size - 1) / record_size * record_size);
+        if (data[offset - 1] == '\n') return offset;
+        const char* end = (const char*)memchr(data + offset, '\n', file_size - offset);
+        return (end == NULL) ? file_size : end - data + 1;
+    }
+
+    void _close(){
+#ifdef linux
+        if (data != NULL && buffer.empty()) munmap((void*)data, file_size);
+        if (fd >= 0) ::close(fd);
+#endif
+        data = NULL;
+        fd = -1;
+        buffer.clear();
+        columns.clear();
+        field_column.clear();
+        num_fields = 0;
+        action_column = -1;
+        reward_column = -1;
+    }
+};
+#endif
@@ -0,0 +1,64 @@
+#ifndef TRAINING_H
+#define TRAINING_H
+#include <vector>
+#include "FiniteMDPModel.h"
+#include "Complex.h"
+
+using namespace std;
+
+/*
+Training of a model on the ComplexScenario, shared by run_model, run_experiments and ingest_trace so that they
+all train the same model for the same seed.
+*/
+
+int randomchoice(State &s, FiniteMDPModel &model)
+{
+    float n = (float)s.qstates.size();
+    float x = 1.0 / n;
+    float r = model.unif(model.eng);
+    for (int i = 1; i < n + 1; i++)
+    {
+        if (r < x * i)
+            return s.qstates[i - 1].get_action();
+    }
+    return s.qstates[0].get_action();
+}
+
+/*
+Trains a model with epsilon-greedy actions on a fresh scenario, running value iteration every 500 steps,
+then makes the last state the initial state of the evaluations and compacts the store.
+Takes as input the model, the number of training steps and a trace receiving every step (may be NULL).
+No output.
+*/
+void train_model(FiniteMDPModel &model, int training_steps = 10000, TraceWriter* trace = NULL){
+    int load_period = 250;
+    int MIN_VMS = 1;
+    int MAX_VMS = 20;
+    float epsilon = 0.7;
+    ComplexScenario scenario(5000, load_period, 10, MIN_VMS, MAX_VMS);
+    vector<int> layout = scenario.get_measurement_layout(model.index_params); //measurements in the order of the model parameters
+    vector<double> meas(layout.size());
+    scenario.get_current_measurements(layout, meas.data());
+    model.set_state(meas.data());
+    if (trace != NULL)
+        trace->write(-1, 0.0, meas.data()); //start of the trajectory
+    int action;
+    for (int time = 0; time < training_steps; time++){
+        float x = model.unif(model.eng);
+        if (x < epsilon)
+            action = randomchoice(model.states[model.current_state_num], model);
+        else
+            action = model.suggest_action();
+        float reward = scenario.execute_action(model.action_vm_change[action]);
+        scenario.get_current_measurements(layout, meas.data());
+        if (trace != NULL)
+            trace->write(action, reward, meas.data());
+        model.update(action, meas.data(), reward);
+        if (time % 500 == 1){
+            model.value_iteration(0.1);
+        }
+    }
+    model.initial_state_num = model.current_state_num;
+    model.transition_store.compact();
+}
+#endif
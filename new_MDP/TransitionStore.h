@@ -0,0 +1,338 @@
+#ifndef TRANSITIONSTORE_H
+#define TRANSITIONSTORE_H
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+/*
+Sparse (CSR) storage for the transitions of every QState of a model.
+Every QState owns one row of the store, which holds only the successor states actually observed
+after taking its action, together with the number of times each one was reached and the sum of
+the rewards collected. The successors of a row are kept sorted (by key(), see successor_keys) and lie in contiguous memory, so a
+Bellman backup streams over successors[offset .. offset+size) instead of a dense num_states vector.
+Probabilities and mean rewards are kept up to date by update(), so the rows can be read at any time.
+A row that runs out of room is moved to the end of the arrays with double its capacity (amortized O(1)),
+compact() removes the gaps left behind once training is over.
+*/
+class TransitionStore{
+public:
+    /*
+    Read-only view of one row: pointers into the store arrays, valid until the row is moved by update() or compact().
+    */
+    struct RowView{
+        const int* successors;
+        const int* counts;
+        const float* reward_sums;
+        const float* probabilities;
+        const float* mean_rewards;
+        int size;
+    };
+
+    //observations of one transition added in bulk by add_transitions()
+    struct TransitionCount{
+        int row;
+        int successor;
+        int count;
+        double reward_sum;
+    };
+
+    vector<int> row_offset = {};    //first slot of every row
+    vector<int> row_size = {};      //number of distinct successors of every row
+    vector<int> row_capacity = {};  //number of slots reserved for every row
+    vector<int> row_taken = {};     //number of transitions recorded in every row
+    vector<int> successors = {};    //successor state ids, sorted by key() inside each row
+    vector<int> successor_keys = {};//sort key of every state id, empty when the ids are their own keys (lazy models: the grid number of every slot)
+    vector<int> counts = {};        //times each successor was reached
+    vector<float> reward_sums = {}; //sum of the rewards collected on each transition
+    vector<float> probabilities = {};//counts normalized by the row's row_taken
+    vector<float> mean_rewards = {}; //reward_sums divided by counts
+    vector<float> reward_corrections = {}; //QState::reward_correction of the row at phase (slot - row start), built by MDPModel::build_reward_tables
+    float reward_table_factor = 0.0;       //reward factor reward_corrections was built with
+    vector<float> cumulative = {};         //running sum of the probabilities of every row, built by build_cumulative
+    vector<float> uniform_cumulative = {}; //same for a QState never taken (uniform prior over every state)
+
+    /*
+    Adds a new (empty) row to the store.
+    No input.
+    Returns the id of the new row.
+    */
+    int add_row(){
+        row_offset.push_back(successors.size());
+        row_size.push_back(0);
+        row_capacity.push_back(0);
+        row_taken.push_back(0);
+        return row_offset.size() - 1;
+    }
+
+    int num_rows(){
+        return row_offset.size();
+    }
+
+    int size(int row){
+        return row_size[row];
+    }
+
+    int begin(int row){
+        return row_offset[row];
+    }
+
+    int end(int row){
+        return row_offset[row] + row_size[row];
+    }
+
+    //position of a state id in the order of the successors of a row
+    int key(int state_num) const{
+        return successor_keys.empty() ? state_num : successor_keys[state_num];
+    }
+
+    //first slot of a row whose successor does not come before a key
+    int _lower_bound(int first, int last, int state_key) const{
+        return lower_bound(successors.begin() + first, successors.begin() + last, state_key,
+                           [this](int successor, int k){ return key(successor) < k; }) - successors.begin();
+    }
+
+    RowView view(int row) const{
+        int first = row_offset[row];
+        return RowView{successors.data() + first, counts.data() + first, reward_sums.data() + first,
+                       probabilities.data() + first, mean_rewards.data() + first, row_size[row]};
+    }
+
+    /*
+    Binary search for a successor inside a row.
+    Takes as input the row and the successor state id.
+    Returns the slot of the successor in the store arrays, or -1 if it has never been observed.
+    */
+    int find(int row, int state_num){
+        int first = row_offset[row];
+        int last = first + row_size[row];
+        int pos = _lower_bound(first, last, key(state_num));
+        if (pos < last && successors[pos] == state_num)
+            return pos;
+        return -1;
+    }
+
+    /*
+    Records one more observed transition of a row towards a successor, collecting the given reward.
+    A successor seen for the first time is inserted at its sorted position.
+    The probabilities of the row are renormalized, costing O(size of the row).
+    No output.
+    */
+    void update(int row, int state_num, float reward){
+        int first = row_offset[row];
+        int last = first + row_size[row];
+        int pos = _lower_bound(first, last, key(state_num));
+        row_taken[row]++;
+        reward_corrections.clear(); //rewards and probabilities change
+        cumulative.clear();
+        if (pos < last && successors[pos] == state_num){
+            counts[pos] += 1;
+            reward_sums[pos] += reward;
+            mean_rewards[pos] = reward_sums[pos] / (float)counts[pos];
+            _normalize(row);
+            return;
+        }
+
+        if (row_size[row] == row_capacity[row]){
+            _grow(row);
+            pos = pos - first + row_offset[row];
+            first = row_offset[row];
+            last = first + row_size[row];
+        }
+        for (int i = last; i > pos; i--){
+            successors[i] = successors[i-1];
+            counts[i] = counts[i-1];
+            reward_sums[i] = reward_sums[i-1];
+            mean_rewards[i] = mean_rewards[i-1];
+        }
+        successors[pos] = state_num;
+        counts[pos] = 1;
+        reward_sums[pos] = reward;
+        mean_rewards[pos] = reward;
+        row_size[row]++;
+        _normalize(row);
+    }
+
+    void _normalize(int row){
+        for (int i = begin(row); i < end(row); i++)
+            probabilities[i] = (float)counts[i]*1.0 /(float)row_taken[row]*1.0;
+    }
+
+    //moves a full row to the end of the arrays, doubling its capacity
+    void _grow(int row){
+        int new_capacity = max(2, 2 * row_capacity[row]);
+        int old_offset = row_offset[row];
+        int new_offset = successors.size();
+        if (old_offset + row_capacity[row] == new_offset){ //row is already the last one, extend it in place
+            new_offset = old_offset;
+        }
+        successors.resize(new_offset + new_capacity);
+        counts.resize(new_offset + new_capacity);
+        reward_sums.resize(new_offset + new_capacity);
+        probabilities.resize(new_offset + new_capacity);
+        mean_rewards.resize(new_offset + new_capacity);
+        if (new_offset != old_offset){
+            for (int i = 0; i < row_size[row]; i++){
+                successors[new_offset + i] = successors[old_offset + i];
+                counts[new_offset + i] = counts[old_offset + i];
+                reward_sums[new_offset + i] = reward_sums[old_offset + i];
+                probabilities[new_offset + i] = probabilities[old_offset + i];
+                mean_rewards[new_offset + i] = mean_rewards[old_offset + i];
+            }
+        }
+        row_offset[row] = new_offset;
+        row_capacity[row] = new_capacity;
+    }
+
+    /*
+    Packs all rows back to back in row order, dropping the unused slots left by _grow().
+    Rows keep no spare capacity afterwards, so the next new successor of a row moves it again.
+    No input.
+    No output.
+    */
+    void compact(){
+        vector<int> new_successors;
+        vector<int> new_counts;
+        vector<float> new_reward_sums;
+        vector<float> new_probabilities;
+        vector<float> new_mean_rewards;
+        int nnz = 0;
+        for (int row = 0; row < row_size.size(); row++) nnz += row_size[row];
+        new_successors.reserve(nnz);
+        new_counts.reserve(nnz);
+        new_reward_sums.reserve(nnz);
+        new_probabilities.reserve(nnz);
+        new_mean_rewards.reserve(nnz);
+        for (int row = 0; row < row_size.size(); row++){
+            int offset = new_successors.size();
+            for (int i = begin(row); i < end(row); i++){
+                new_successors.push_back(successors[i]);
+                new_counts.push_back(counts[i]);
+                new_reward_sums.push_back(reward_sums[i]);
+                new_probabilities.push_back(probabilities[i]);
+                new_mean_rewards.push_back(mean_rewards[i]);
+            }
+            row_offset[row] = offset;
+            row_capacity[row] = row_size[row];
+        }
+        reward_corrections.clear();
+        cumulative.clear();
+        successors.swap(new_successors);
+        counts.swap(new_counts);
+        reward_sums.swap(new_reward_sums);
+        probabilities.swap(new_probabilities);
+        mean_rewards.swap(new_mean_rewards);
+    }
+
+    /*
+    Records many observed transitions at once, such as the ones accumulated from a trace: the counts and reward
+    sums are added to the existing ones and every row is rebuilt in one pass, O(nonzeros + added), leaving the
+    store compacted. Counts and probabilities are the ones update() would give, the reward sums are
+    added as given instead of one reward at a time.
+    Takes as input the transitions, sorted by row and key() of the successor, each pair at most once.
+    No output.
+    */
+    void add_transitions(const vector<TransitionCount> &added){
+        vector<int> new_successors, new_counts;
+        vector<float> new_reward_sums;
+        int nnz = nonzeros() + added.size();
+        new_successors.reserve(nnz);
+        new_counts.reserve(nnz);
+        new_reward_sums.reserve(nnz);
+        int j = 0;
+        for (int row = 0; row < row_size.size(); row++){
+            int offset = new_successors.size();
+            int i = begin(row);
+            while (j < added.size() && added[j].row < row) j++; //rows the store does not have
+            while (i < end(row) || (j < added.size() && added[j].row == row)){
+                bool old_first = i < end(row) && (j == added.size() || added[j].row != row || key(successors[i]) <= key(added[j].successor));
+                bool new_first = j < added.size() && added[j].row == row && (i == end(row) || key(added[j].successor) <= key(successors[i]));
+                new_successors.push_back(old_first ? successors[i] : added[j].successor);
+                new_counts.push_back((old_first ? counts[i] : 0) + (new_first ? added[j].count : 0));
+                new_reward_sums.push_back((old_first ? reward_sums[i] : 0.0f) + (new_first ? (float)added[j].reward_sum : 0.0f));
+                if (new_first) row_taken[row] += added[j].count;
+                if (old_first) i++;
+                if (new_first) j++;
+            }
+            row_offset[row] = offset;
+            row_size[row] = new_successors.size() - offset;
+            row_capacity[row] = row_size[row];
+        }
+        successors.swap(new_successors);
+        counts.swap(new_counts);
+        reward_sums.swap(new_reward_sums);
+        probabilities.assign(successors.size(), 0.0);
+        mean_rewards.assign(successors.size(), 0.0);
+        for (int row = 0; row < row_size.size(); row++){
+            for (int i = begin(row); i < end(row); i++)
+                mean_rewards[i] = reward_sums[i] / (float)counts[i];
+            _normalize(row);
+        }
+        reward_corrections.clear();
+        cumulative.clear();
+    }
+
+    //whether reward_corrections is up to date for the given reward factor
+    bool has_reward_table(float reward_factor){
+        return !reward_corrections.empty() && reward_corrections.size() == successors.size() && reward_factor == reward_table_factor;
+    }
+
+    /*
+    Builds the cumulative distribution of every row, and of the uniform prior over num_states states, for sample().
+    The sums are accumulated in the same order and precision as a linear walk over the row, so sample() picks
+    exactly the successor the walk would pick.
+    Takes as input the number of states of the model.
+    No output.
+    */
+    void build_cumulative(int num_states){
+        cumulative.assign(successors.size(), 0.0);
+        for (int row = 0; row < row_size.size(); row++){
+            float acc = 0.0;
+            for (int i = begin(row); i < end(row); i++){
+                acc += probabilities[i];
+                cumulative[i] = acc;
+            }
+        }
+        uniform_cumulative.assign(num_states, 0.0);
+        float t = 1.0 / (float)num_states;
+        float acc = 0.0;
+        for (int i = 0; i < num_states; i++){
+            acc += t;
+            uniform_cumulative[i] = acc;
+        }
+    }
+
+    bool has_cumulative(){
+        return !cumulative.empty() && cumulative.size() == successors.size();
+    }
+
+    /*
+    Samples a successor of a row by binary search on its cumulative distribution, O(log size of the row).
+    Takes as input the row and a uniform number x in [0, 1).
+    Returns the slot of the first successor whose cumulative probability exceeds x, or -1 if rounding left x above them all.
+    */
+    int sample(int row, float x){
+        int pos = upper_bound(cumulative.begin() + begin(row), cumulative.begin() + end(row), x) - cumulative.begin();
+        return (pos < end(row)) ? pos : -1;
+    }
+
+    //same as sample() for the uniform prior, returns the sampled state or -1
+    int sample_uniform(float x){
+        int pos = upper_bound(uniform_cumulative.begin(), uniform_cumulative.end(), x) - uniform_cumulative.begin();
+        return (pos < uniform_cumulative.size()) ? pos : -1;
+    }
+
+    //number of stored (non-zero) transitions
+    int nonzeros(){
+        int nnz = 0;
+        for (int row = 0; row < row_size.size(); row++) nnz += row_size[row];
+        return nnz;
+    }
+
+    //bytes held by the store
+    size_t memory_used(){
+        return (row_offset.capacity() + row_size.capacity() + row_capacity.capacity() + row_taken.capacity() + successors.capacity() + counts.capacity()) * sizeof(int)
+                + (reward_sums.capacity() + probabilities.capacity() + mean_rewards.capacity() + reward_corrections.capacity() + cumulative.capacity()) * sizeof(float);
+    }
+};
+#endif
@@ -0,0 +1,41 @@
+#ifndef VALUEFUNCTION_H
+#define VALUEFUNCTION_H
+#include <vector>
+
+using namespace std;
+
+/*
+Value function of a model at one step of a finite-horizon evaluation: the value and the index of the best QState
+of every state, kept in two flat arrays. The evaluators back up from one ValueFunction into a second, preallocated
+one and swap them, so a horizon step neither allocates nor copies the value function.
+*/
+class ValueFunction{
+public:
+    vector<float> values = {};      //value of every state
+    vector<int> best_qstates = {};  //index of the best QState of every state
+
+    ValueFunction(int num_states = 0){
+        resize(num_states);
+    }
+
+    void resize(int num_states){
+        values.resize(num_states, 0.0);
+        best_qstates.resize(num_states, 0);
+    }
+
+    int size() const{
+        return values.size();
+    }
+
+    //O(1), exchanges the arrays of the two value functions
+    void swap(ValueFunction &other){
+        values.swap(other.values);
+        best_qstates.swap(other.best_qstates);
+    }
+
+    //bytes held by the value function
+    size_t memory_used() const{
+        return values.capacity() * sizeof(float) + best_qstates.capacity() * sizeof(int);
+    }
+};
+#endif
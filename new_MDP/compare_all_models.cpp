@@ -20,7 +20,7 @@ and execute by typing:
     .\output_script.exe <model_parameters.json>
 
 To compile in Linux, type in a terminal:
-    g++ -o output_script.sh compare_all_models.cpp
+    g++ -pthread -o output_script.sh compare_all_models.cpp
 and execute by typing:
     ./output_script.exe <model_parameters.json>
 
@@ -45,18 +45,18 @@ float avg(vector<float> v)
 }
 
 
-pair<string, int> randomchoice(vector<pair<string, int>> v, FiniteMDPModel &model)
+int randomchoice(State &s, FiniteMDPModel &model)
 {
-    float n = (float)v.size();
+    float n = (float)s.qstates.size();
     float x = 1.0 / n;
     //float r = myRand(0, 1);
     float r = model.unif(model.eng);
     for (int i = 1; i < n + 1; i++)
     {
         if (r < x * i)
-            return v[i - 1];
+            return s.qstates[i - 1].get_action();
     }
-    return v[0];
+    return s.qstates[0].get_action();
 }
 
 int main(int argc, char *argv[])
@@ -83,47 +83,33 @@ int main(int argc, char *argv[])
 
     ComplexScenario scenario(5000, load_period, 10, MIN_VMS, MAX_VMS);
 
-    pair<string, int> action;
+    int action;
     for (int number_of_tests =0; number_of_tests < num_tests; number_of_tests++){
     FiniteMDPModel model(conf.get_model_conf(), seed);
     model.set_state(scenario.get_current_measurements());
     float total_reward = 0.0;
+    vector<int> layout = scenario.get_measurement_layout(model.index_params); //measurements in the order of the model parameters
+    vector<double> meas(layout.size());
     
     for (int time = 0; time < training_steps; time++){
     
         float x = model.unif(model.eng);
         if (x < epsilon)
         {
-            action = randomchoice(model.get_legal_actions(), model);
+            action = randomchoice(model.states[model.current_state_num], model);
         }
         else
         {
             action = model.suggest_action();
         }
-        float reward = scenario.execute_action(action);
-        json meas = scenario.get_current_measurements();
-        model.update(action, meas, reward);
+        float reward = scenario.execute_action(model.action_vm_change[action]);
+        scenario.get_current_measurements(layout, meas.data());
+        model.update(action, meas.data(), reward);
         if (time % 500 == 1){
             model.value_iteration(0.1);
         }
     }
-    int count0=0;
-    int count1=0;
-    //max_memory_used = getValue();
-    for (int i=0;i< model.states.size();i++){
-        for (int j=0;j< model.states[i].qstates.size();j++){
-            for (int k=0;k< model.states[i].qstates[j].transitions.size();k++){
-                if (model.states[i].qstates[j].get_transition(k)>0){
-                    model.states[i].qstates[j].trans.push_back(model.states[i].qstates[j].get_transition(k));
-                    model.states[i].qstates[j].transtate.push_back(k);
-                    count1++;
-                }
-                else {
-                    count0++;
-                }
-            }
-        }
-    }
+    model.transition_store.compact();
     model.initial_state_num = model.current_state_num;
     //model.discount=1; //for the infiniteM to test the discount=1
         for (int j = 0; j < 1; j++){//just to test the same model results
@@ -0,0 +1,149 @@
+#include <iostream>
+#include "FiniteMDPModel.h"
+#include "ModelConf.h"
+#include <vector>
+#include "Complex.h"
+#include "Training.h"
+#include <sstream>
+
+#include "stdlib.h"
+#include "stdio.h"
+#include <string>
+
+/*
+
+This script checks that a model with lazy states ("lazy_states": true) behaves exactly like the eager model
+of the same configuration: both are trained with the same seed, then every algorithm is run on both and its
+expected and collected rewards must be identical. It then trains both again for at most 1000 steps with
+"incremental_update" (no backup limit and no full value iteration), so that the values come only from the local
+backups, and checks that every state of the grid ends with values within the update error of each other and,
+when the lazy model reached it, with the same number of QStates never taken.
+
+To compile in Linux, type in a terminal:
+    g++ -O2 -pthread -o compare_lazy.exe compare_lazy.cpp
+and execute by typing:
+    ./compare_lazy.exe [<model_parameters.json>] [<horizon>] [<seed>] [<training_steps>]
+which defaults to ./model_parameters/mdp_small_1.json, a horizon of 200, seed 21 and 10000 training steps.
+The rewards are identical once training reaches every state of the grid, as it does by default. With fewer
+training steps the expected rewards can differ in the last digits: the uniform prior adds the states a lazy
+model never reached as one product, where the eager model adds them one by one.
+The exit status is 1 if any algorithm gives different rewards, or any state a different incremental value or
+number of QStates never taken, on the two models.
+
+*/
+
+using namespace std;
+
+/*
+Trains a model and runs every algorithm on it, restarting from the trained state each time.
+Takes as input the model configuration, whether its states are lazy, the horizon, the seed, the number of
+training steps and the expected and collected rewards to fill, one per algorithm.
+No output.
+*/
+void run_all(json model_conf, bool lazy, int horizon, int seed, int training_steps, const vector<model_type> &algorithms,
+             vector<float> &expected, vector<float> &collected){
+    model_conf["lazy_states"] = lazy;
+    FiniteMDPModel model(model_conf, seed);
+    train_model(model, training_steps);
+    model.set_checkpoint_codec(checkpoint_full);
+    default_random_engine trained_eng = model.eng;
+    cout << (lazy ? "Lazy" : "Eager") << " model: " << model.states.size() << " states in memory" << endl;
+    for (model_type algo : algorithms){
+        model.resetModel();
+        model.eng = trained_eng;
+        ostringstream log;
+        model.output = &log;
+        model.runAlgorithm(algo, horizon);
+        expected.push_back(model.expected_reward);
+        collected.push_back(model.total_reward);
+    }
+}
+
+/*
+Trains a model with "incremental_update" and random actions, without any full value iteration.
+Takes as input the model configuration, whether its states are lazy, the seed, the number of training steps,
+and the places for the value of every state of the grid (the value of slot 0 for the states a lazy model never
+reached), its number of QStates never taken, whether it is in memory (false for the states a lazy model never
+reached, whose count is the one of slot 0), the largest
+distance of the values to the ones of value iteration run to convergence afterwards and the update error.
+No output.
+*/
+void run_incremental(json model_conf, bool lazy, int seed, int training_steps, vector<float> &values, vector<int> &untaken,
+                     vector<char> &reached, float &distance, float &update_error){
+    model_conf["lazy_states"] = lazy;
+    model_conf["incremental_update"] = true;
+    model_conf["local_backup_limit"] = 0;
+    FiniteMDPModel model(model_conf, seed);
+    ComplexScenario scenario(5000, 250, 10, 1, 20);
+    vector<int> layout = scenario.get_measurement_layout(model.index_params);
+    vector<double> meas(layout.size());
+    scenario.get_current_measurements(layout, meas.data());
+    model.set_state(meas.data());
+    for (int time = 0; time < training_steps; time++){
+        int action = randomchoice(model.states[model.current_state_num], model);
+        float reward = scenario.execute_action(model.action_vm_change[action]);
+        scenario.get_current_measurements(layout, meas.data());
+        model.update(action, meas.data(), reward);
+    }
+    for (int i = 0; i < model.num_potential_states; i++){
+        int slot = lazy ? model._slot(i) : i;
+        values.push_back(model.states[slot].value);
+        untaken.push_back(model.local_untaken[slot]);
+        reached.push_back(!lazy || slot != 0);
+    }
+    update_error = model.update_error;
+    model.value_iteration(1e-5);
+    distance = 0.0;
+    for (int i = 0; i < model.num_potential_states; i++)
+        distance = max(distance, abs(values[i] - model.states[lazy ? model._slot(i) : i].value));
+}
+
+int main(int argc, char *argv[])
+{
+    string CONF_FILE = (argc > 1) ? argv[1] : "./model_parameters/mdp_small_1.json";
+    int horizon = (argc > 2) ? atoi(argv[2]) : 200;
+    int seed = (argc > 3) ? atoi(argv[3]) : 21;
+    int training_steps = (argc > 4) ? atoi(argv[4]) : 10000;
+    ModelConf conf(CONF_FILE);
+    vector<model_type> algorithms = {infinite, infiniteM, naive, root, tree, inplace, revolve};
+    vector<string> names = {"infinite", "infinitem", "naive", "root", "tree", "inplace", "revolve"};
+
+    vector<float> eager_expected, eager_collected, lazy_expected, lazy_collected;
+    run_all(conf.get_model_conf(), false, horizon, seed, training_steps, algorithms, eager_expected, eager_collected);
+    run_all(conf.get_model_conf(), true, horizon, seed, training_steps, algorithms, lazy_expected, lazy_collected);
+
+    int mismatches = 0;
+    for (int i = 0; i < algorithms.size(); i++){
+        bool same = eager_expected[i] == lazy_expected[i] && eager_collected[i] == lazy_collected[i];
+        cout << names[i] << "\texpected " << eager_expected[i] << " / " << lazy_expected[i]
+             << "\tcollected " << eager_collected[i] << " / " << lazy_collected[i] << (same ? "" : "\tMISMATCH") << endl;
+        if (!same) mismatches++;
+    }
+
+    //few enough steps that part of the grid is never reached and many QStates are never taken
+    int incremental_steps = min(training_steps, 1000);
+    vector<float> eager_values, lazy_values;
+    vector<int> eager_untaken, lazy_untaken;
+    vector<char> eager_reached, lazy_reached;
+    float eager_distance, lazy_distance, update_error;
+    run_incremental(conf.get_model_conf(), false, seed, incremental_steps, eager_values, eager_untaken, eager_reached, eager_distance, update_error);
+    run_incremental(conf.get_model_conf(), true, seed, incremental_steps, lazy_values, lazy_untaken, lazy_reached, lazy_distance, update_error);
+    //the local backups stop within update_error, so the values agree within it; the QStates never taken agree exactly
+    int states_differing = 0;
+    float largest = 0.0;
+    for (int i = 0; i < eager_values.size(); i++){
+        largest = max(largest, abs(eager_values[i] - lazy_values[i]));
+        if (abs(eager_values[i] - lazy_values[i]) > update_error || (lazy_reached[i] && lazy_untaken[i] != eager_untaken[i]))
+            states_differing++;
+    }
+    cout << "incremental\tdistance to value iteration " << eager_distance << " / " << lazy_distance << "\tvalues differ by up to "
+         << largest << "\t" << states_differing << " states differ" << (states_differing == 0 ? "" : "\tMISMATCH") << endl;
+    if (states_differing > 0) mismatches++;
+
+    if (mismatches > 0){
+        cout << mismatches << " of " << algorithms.size() + 1 << " checks differ between the eager and the lazy model" << endl;
+        return 1;
+    }
+    cout << "The eager and the lazy model give the same rewards and values" << endl;
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <iostream>
+#include "FiniteMDPModel.h"
+#include "ModelConf.h"
+#include <vector>
+#include "Complex.h"
+#include "Training.h"
+#include <chrono>
+
+#include "stdlib.h"
+#include "stdio.h"
+#include <string>
+
+/*
+
+This script builds a model from logged trajectories instead of training it on a live scenario.
+
+To compile in Linux, type in a terminal:
+    g++ -O2 -pthread -o ingest_trace.exe ingest_trace.cpp
+and execute by typing:
+    ./ingest_trace.exe <trace> <snapshot> [<threads>] [<seed>] [<model_parameters.json>]
+to learn the transitions of the trace (see TraceFile.h for the CSV and binary formats) with <threads> threads,
+run value iteration and save the model to <snapshot>, which run_model and run_experiments can then load, or
+    ./ingest_trace.exe record <trace> [<seed>] [<training_steps>] [<model_parameters.json>]
+to write the trajectory run_model trains on to <trace> (CSV if it ends with .csv, binary otherwise).
+
+*/
+
+using namespace std::chrono;
+
+using namespace std;
+
+/*
+Trains a model as run_model does, writing every step to a trace.
+Returns 0, or 1 if the trace cannot be written.
+*/
+int record(string trace_file, int seed, int training_steps, string conf_file){
+    ModelConf conf(conf_file);
+    FiniteMDPModel model(conf.get_model_conf(), seed);
+    TraceWriter trace;
+    if (!trace.open(trace_file, model.index_params)){
+        cout << "Cannot write " << trace_file << endl;
+        return 1;
+    }
+    train_model(model, training_steps, &trace);
+    return trace.close() ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    string conf_file = "./model_parameters/mdp_small_1.json";
+    if (argc > 2 && string(argv[1]) == "record"){
+        int seed = (argc > 3) ? stoi(argv[3]) : 21;
+        int training_steps = (argc > 4) ? stoi(argv[4]) : 10000;
+        if (argc > 5) conf_file = argv[5];
+        return record(argv[2], seed, training_steps, conf_file);
+    }
+    if (argc < 3){
+        cout << "Usage: " << argv[0] << " <trace> <snapshot> [<threads>] [<seed>] [<model_parameters.json>]" << endl;
+        cout << "       " << argv[0] << " record <trace> [<seed>] [<training_steps>] [<model_parameters.json>]" << endl;
+        return 1;
+    }
+    int num_threads = (argc > 3) ? stoi(argv[3]) : 1;
+    int seed = (argc > 4) ? stoi(argv[4]) : 21;
+    if (argc > 5) conf_file = argv[5];
+
+    ModelConf conf(conf_file);
+    FiniteMDPModel model(conf.get_model_conf(), seed);
+    model.set_num_threads(num_threads);
+    auto start = high_resolution_clock::now();
+    long long learned = model.ingest_trace(argv[1]);
+    if (learned < 0)
+        return 1;
+    auto stop = high_resolution_clock::now();
+    double seconds = duration_cast<microseconds>(stop - start).count() * 0.000001;
+    cout << "Transitions learned: " << learned << endl;
+    cout << "Ingestion time (sec): " << seconds << " (" << learned / max(seconds, 1e-6) / 1000000.0 << " M transitions/sec)" << endl;
+    model.value_iteration(0.1);
+    model.initial_state_num = model.current_state_num;
+    if (!model.save_snapshot(argv[2])){
+        cout << "Cannot write the snapshot " << argv[2] << endl;
+        return 1;
+    }
+    cout << "Model saved to " << argv[2] << endl;
+}
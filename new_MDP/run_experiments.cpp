@@ -0,0 +1,241 @@
+#include <iostream>
+#include "FiniteMDPModel.h"
+#include "ModelConf.h"
+#include <vector>
+#include "Complex.h"
+#include "Training.h"
+#include <chrono>
+#include <sstream>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <random>
+#include <functional>
+#include <filesystem>
+#include <cstdio>
+
+#include "stdlib.h"
+#include "stdio.h"
+#include <string>
+
+/*
+
+This script runs a whole sweep of experiments in one process, instead of one run_model execution per
+algorithm, horizon, seed and discount.
+
+To compile in Linux, type in a terminal:
+    g++ -O2 -pthread -o run_experiments.exe run_experiments.cpp
+and execute by typing:
+    ./run_experiments.exe <sweep.json> [<results.json>]
+
+where <sweep.json> describes the sweep, for example:
+    {
+        "model": "./model_parameters/mdp_small_1.json",
+        "algorithms": ["naive", "root", "tree", "infinite"],
+        "horizons": [100, 1000, 10000],
+        "seeds": [79, 885, 987, 297],
+        "discounts": [0.1, 0.5, 0.99],
+        "threads": 4,
+        "training_steps": 10000,
+        "rollouts": 0,
+        "snapshot_dir": "./snapshots"
+    }
+Only "algorithms", "horizons" and "seeds" are required. "discounts" defaults to [0.5], "threads" to the number
+of cores and "rollouts", when above 0, adds the mean, variance and 95% confidence interval of that many
+executions of every policy to its result.
+With "snapshot_dir", the trained model of every seed is loaded from <snapshot_dir>/seed_<seed>.mdps when the
+file exists, and saved there after training otherwise.
+<results.json> (results.json by default) receives the sweep and one entry per algorithm, horizon, seed and
+discount, in that order within a seed and in the order of the seeds.
+
+The model of a seed is trained once and every evaluation of the seed is run on it, restarting from the
+trained state each time, so every entry is the same as the run_model execution with the same arguments.
+The sweep runs in two phases: the threads first take whole seeds, training each model and saving it to a
+snapshot (in "snapshot_dir", or in a temporary file removed at the end), then take the evaluations one by one,
+whatever their seed. The evaluators keep their working values in the states of the model, so every thread
+loads its own copy of the model of a seed from the snapshot instead of sharing it, and the configuration
+file is parsed once for all of them. The training phase uses at most one thread per seed, while the
+evaluations of a single seed use every thread.
+
+*/
+
+using namespace std::chrono;
+
+using namespace std;
+
+/*
+Trains the model of one seed, unless the snapshot file already holds a model that can be loaded, and saves it
+to the snapshot file.
+Takes as input the model configuration, the sweep, the seed and the snapshot file.
+Returns the training (or loading) time in seconds, or -1 if the model cannot be saved.
+*/
+float train_seed(const json &model_conf, const json &sweep, int seed, string snapshot){
+    bool use_snapshot = std::ifstream(snapshot).good();
+    FiniteMDPModel model(use_snapshot ? json({}) : model_conf, seed);
+    auto start = high_resolution_clock::now();
+    if (!use_snapshot || !model.load_snapshot(snapshot)){
+        if (use_snapshot){ //the file cannot be loaded: train the model from its configuration
+            FiniteMDPModel trained(model_conf, seed);
+            train_model(trained, sweep["training_steps"]);
+            if (!trained.save_snapshot(snapshot))
+                return -1;
+        }
+        else {
+            train_model(model, sweep["training_steps"]);
+            if (!model.save_snapshot(snapshot))
+                return -1;
+        }
+    }
+    return duration_cast<microseconds>(high_resolution_clock::now() - start).count() * 0.000001;
+}
+
+/*
+Runs one evaluation of the sweep on a trained model, restarting from the trained state.
+Takes as input the model, the state of its random engine after training, the sweep, the seed, the training
+time, the discount, the algorithm name, the horizon and the entry to fill.
+No output.
+*/
+void evaluate(FiniteMDPModel &model, const default_random_engine &trained_eng, const json &sweep, int seed,
+              float training_time, float discount, string name, int horizon, json &entry){
+    model_type algo;
+    parse_algorithm(name, algo);
+    model.resetModel();
+    model.eng = trained_eng; //every evaluation draws the numbers a fresh process would draw
+    model.discount = discount;
+    ostringstream log;
+    model.output = &log;
+    model.runAlgorithm(algo, horizon);
+    entry = {{"algorithm", name}, {"horizon", horizon}, {"seed", seed}, {"discount", discount},
+             {"expected_reward", model.expected_reward}, {"total_reward", model.total_reward},
+             {"execution_time", model.execution_time}, {"training_time", training_time}};
+    if (algo == root || algo == tree || algo == revolve)
+        entry["checkpoint_memory"] = model.max_stack_memory;
+    if (algo == revolve)
+        entry["recomputed_steps"] = model.recomputed_backups;
+    int rollouts = sweep["rollouts"];
+    if (rollouts > 0){
+        RolloutStats stats = model.rolloutEvaluation(algo, horizon, rollouts, seed);
+        entry["rollouts"] = {{"count", stats.num_rollouts}, {"mean", stats.mean}, {"variance", stats.variance},
+                             {"ci_low", stats.ci_low}, {"ci_high", stats.ci_high}};
+    }
+}
+
+/*
+Runs a task on the calling thread and on threads - 1 other threads, and waits for all of them.
+Takes as input the number of threads and the task.
+No output.
+*/
+void run_threads(int threads, const function<void()> &task){
+    vector<thread> workers;
+    for (int t = 1; t < threads; t++)
+        workers.push_back(thread(task));
+    task();
+    for (auto& w:workers) w.join();
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2){
+        cout << "Usage: " << argv[0] << " <sweep.json> [<results.json>]" << endl;
+        return 1;
+    }
+    std::ifstream ifs(argv[1]);
+    json sweep = json::parse(ifs);
+    string results_file = (argc > 2) ? argv[2] : "results.json";
+    if (!sweep.contains("model")) sweep["model"] = "./model_parameters/mdp_small_1.json";
+    if (!sweep.contains("discounts")) sweep["discounts"] = {0.5};
+    if (!sweep.contains("training_steps")) sweep["training_steps"] = 10000;
+    if (!sweep.contains("rollouts")) sweep["rollouts"] = 0;
+    if (!sweep.contains("threads")) sweep["threads"] = max(1u, thread::hardware_concurrency());
+    for (string name : sweep["algorithms"]){
+        model_type algo;
+        if (!parse_algorithm(name, algo)){
+            cout << "Invalid Model Type " << name << ". Valid model types are: infinite, infinitem, naive, root, tree, inplace, revolve" << endl;
+            return 1;
+        }
+    }
+
+    ModelConf conf(sweep["model"]);
+    json model_conf = conf.get_model_conf();
+    vector<int> seeds = sweep["seeds"];
+    int num_discounts = sweep["discounts"].size();
+    int num_algorithms = sweep["algorithms"].size();
+    int num_horizons = sweep["horizons"].size();
+    int per_seed = num_discounts * num_algorithms * num_horizons;
+    vector<json> entries(seeds.size() * per_seed);
+    int num_threads = sweep["threads"];
+
+    vector<string> snapshots(seeds.size());
+    bool temporary = !sweep.contains("snapshot_dir");
+    string tag = to_string(random_device()());
+    for (size_t i = 0; i < seeds.size(); i++){
+        if (temporary)
+            snapshots[i] = (filesystem::temp_directory_path() / ("run_experiments_" + tag + "_seed_" + to_string(seeds[i]) + ".mdps")).string();
+        else
+            snapshots[i] = (string)sweep["snapshot_dir"] + "/seed_" + to_string(seeds[i]) + ".mdps";
+    }
+
+    auto start = high_resolution_clock::now();
+    vector<float> training_time(seeds.size());
+    atomic<int> next_seed(0);
+    run_threads(min(num_threads, (int)seeds.size()), [&](){
+        for (int i = next_seed++; i < (int)seeds.size(); i = next_seed++)
+            training_time[i] = train_seed(model_conf, sweep, seeds[i], snapshots[i]);
+    });
+    for (size_t i = 0; i < seeds.size(); i++){
+        if (training_time[i] < 0){
+            cout << "Cannot save the trained model of seed " << seeds[i] << " to " << snapshots[i] << endl;
+            return 1;
+        }
+    }
+
+    atomic<int> next_task(0);
+    vector<atomic<int>> remaining(seeds.size());
+    for (auto& r : remaining) r = per_seed;
+    mutex print_lock;
+    bool load_failed = false;
+    run_threads(num_threads, [&](){
+        unique_ptr<FiniteMDPModel> model; //the thread's copy of the model of the seed it is evaluating
+        int loaded = -1;
+        default_random_engine trained_eng;
+        for (int task = next_task++; task < (int)entries.size(); task = next_task++){
+            int i = task / per_seed;
+            int n = task % per_seed; //discount, then algorithm, then horizon
+            if (i != loaded){
+                model.reset(new FiniteMDPModel(json({}), seeds[i]));
+                if (!model->load_snapshot(snapshots[i])){
+                    unique_lock<mutex> guard(print_lock);
+                    load_failed = true;
+                    cout << "Cannot load the trained model of seed " << seeds[i] << " from " << snapshots[i] << endl;
+                    loaded = -1;
+                    continue;
+                }
+                model->set_checkpoint_codec(checkpoint_full);
+                trained_eng = model->eng;
+                loaded = i;
+            }
+            evaluate(*model, trained_eng, sweep, seeds[i], training_time[i],
+                     sweep["discounts"][n / (num_algorithms * num_horizons)],
+                     sweep["algorithms"][(n / num_horizons) % num_algorithms],
+                     sweep["horizons"][n % num_horizons], entries[task]);
+            if (--remaining[i] == 0){
+                unique_lock<mutex> guard(print_lock);
+                cout << "Seed " << seeds[i] << " done" << endl;
+            }
+        }
+    });
+    if (temporary){
+        for (string path : snapshots)
+            std::remove(path.c_str());
+    }
+    if (load_failed)
+        return 1;
+    auto duration = duration_cast<microseconds>(high_resolution_clock::now() - start);
+
+    json results = {{"sweep", sweep}, {"results", entries}, {"execution_time", duration.count() * 0.000001}};
+    std::ofstream ofs(results_file);
+    ofs << results.dump(2) << endl;
+    cout << entries.size() << " experiments written to " << results_file << " in " << duration.count() * 0.000001 << " sec" << endl;
+}
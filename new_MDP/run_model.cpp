@@ -3,8 +3,10 @@
 #include "ModelConf.h"
 #include <vector>
 #include "Complex.h"
+#include "Training.h"
 #include <chrono>
 #include <sstream>
+#include <fstream>
 
 
 #include "stdlib.h"
@@ -18,16 +20,28 @@ This script is used to run only ONE model and create measurements.
 To compile in Windows, type in a terminal:
     g++ -o output_script.exe run_model.cpp -lpsapi
 and execute by typing:
-    .\output_script.exe <algorithm_type> <horizon_size> <seed>
+    .\output_script.exe <algorithm_type> <horizon_size> <seed> <discount> [<threads>] [<solver>] [<codec>] [<max_error>] [<spill_dir>] [<budget>] [<rollouts>] [<snapshot>]
 
 To compile in Linux, type in a terminal:
-    g++ -o output_script.sh run_model.cpp
+    g++ -pthread -o output_script.sh run_model.cpp
 and execute by typing:
-    ./output_script.exe <algorithm_type> <horizon_size> <seed>
+    ./output_script.exe <algorithm_type> <horizon_size> <seed> <discount> [<threads>] [<solver>] [<codec>] [<max_error>] [<spill_dir>] [<budget>] [<rollouts>] [<snapshot>]
 
-where <algorithm_type> can be: infinite, naive, root, tree, inplace
+where <algorithm_type> can be: infinite, infinitem, naive, root, tree, inplace, revolve
 <horizon_size> can be any positive integer
-and <seed> can be any positive integer
+<seed> can be any positive integer
+<discount> is the discount used by the algorithms
+<threads> is the number of threads sharing every Bellman sweep (1 by default)
+<solver> is the solver of the infinite model: jacobi (default), gauss_seidel, prioritized, modified_policy or policy
+(the two policy solvers need a discount below 1)
+<codec> is the encoding of the root/tree checkpoints: full (default), fp16 or quantized
+<max_error> is the error bound of the quantized checkpoints (0.01 by default)
+<spill_dir> is a directory where the naive method keeps its policy in a memory-mapped file (in memory by default, - for memory)
+<budget> is the memory of the revolve method, in checkpoints (log2 of the horizon by default, - for the default) or in bytes with a B/KB/MB/GB suffix
+<rollouts>, when given, is a number of independent executions of the policy, run in parallel after training once,
+reported as the mean, variance and 95% confidence interval of the collected reward instead of a single trajectory (0 for none)
+and <snapshot> is a model snapshot file: the trained model is loaded from it if it exists, otherwise the model is
+trained and saved to it, so that later executions with the same seed skip the training (- for none)
 
 */
 
@@ -48,18 +62,14 @@ float avg(vector<float> v)
 }
 
 
-pair<string, int> randomchoice(vector<pair<string, int>> v, FiniteMDPModel &model)
+int usage(string program)
 {
-    float n = (float)v.size();
-    float x = 1.0 / n;
-    //float r = myRand(0, 1);
-    float r = model.unif(model.eng);
-    for (int i = 1; i < n + 1; i++)
-    {
-        if (r < x * i)
-            return v[i - 1];
-    }
-    return v[0];
+    cout << "Usage: " << program << " <algorithm_type> <horizon_size> <seed> <discount> [<threads>] [<solver>] [<codec>] [<max_error>] [<spill_dir>] [<budget>] [<rollouts>] [<snapshot>]" << endl;
+    cout << "   <algorithm_type>: infinite, infinitem, naive, root, tree, inplace or revolve" << endl;
+    cout << "   <solver>: jacobi, gauss_seidel, prioritized, modified_policy or policy (the last two need a discount below 1)" << endl;
+    cout << "   <codec>: full, fp16 or quantized" << endl;
+    cout << "   <budget>: a number of checkpoints, or of bytes with a B/KB/MB/GB suffix" << endl;
+    return 1;
 }
 
 int main(int argc, char *argv[])
@@ -68,88 +78,106 @@ int main(int argc, char *argv[])
     string algorithm_type = "none";
     int seed = 21;
     model_type algo;
-    if (argc >1) {
-        algorithm_type = argv[1];
-        if (algorithm_type == "infinite") algo = infinite;
-        else if (algorithm_type == "infinitem") algo = infiniteM;
-        else if (algorithm_type == "naive") algo = naive;
-        else if (algorithm_type == "root") algo = root;
-        else if (algorithm_type == "tree") algo = tree;
-        else if (algorithm_type == "inplace") algo = inplace;
-    }
     float gama = 0.5;
-    /*if (argc == 5){
-        std::size_t pos;
-        horizon = std::stoi(argv[2], &pos);
-        seed = std::stoi(argv[3], &pos);
-        gama = std::stof(argv[4], &pos);
-    }*/
+    if (argc < 5)
+        return usage(argv[0]);
+    algorithm_type = argv[1];
+    if (!parse_algorithm(algorithm_type, algo)){
+        cout << "Invalid Model Type " << algorithm_type << ". Valid model types are: infinite, infinitem, naive, root, tree, inplace, revolve" << endl;
+        return usage(argv[0]);
+    }
     std::size_t pos;
     horizon = std::stoi(argv[2], &pos);
     seed = std::stoi(argv[3], &pos);
     gama = std::stof(argv[4], &pos);
+    int num_threads = 1;
+    if (argc > 5) num_threads = std::stoi(argv[5], &pos);
+    vi_solver solver = jacobi;
+    if (argc > 6){
+        string solver_type = argv[6];
+        if (solver_type == "gauss_seidel") solver = gauss_seidel;
+        else if (solver_type == "prioritized") solver = prioritized;
+        else if (solver_type == "modified_policy") solver = modified_policy;
+        else if (solver_type == "policy") solver = policy_iteration;
+        else if (solver_type != "jacobi"){
+            cout << "Invalid solver " << solver_type << "." << endl;
+            return usage(argv[0]);
+        }
+    }
+    if ((solver == modified_policy || solver == policy_iteration) && gama >= 1.0){
+        cout << "The " << argv[6] << " solver needs a discount below 1." << endl;
+        return usage(argv[0]);
+    }
+    checkpoint_codec codec = checkpoint_full;
+    if (argc > 7){
+        string codec_type = argv[7];
+        if (codec_type == "fp16") codec = checkpoint_fp16;
+        else if (codec_type == "quantized") codec = checkpoint_quantized;
+        else if (codec_type != "full"){
+            cout << "Invalid codec " << codec_type << "." << endl;
+            return usage(argv[0]);
+        }
+    }
+    float max_error = 0.01;
+    if (argc > 8) max_error = std::stof(argv[8], &pos);
+    string spill_dir = "";
+    if (argc > 9 && string(argv[9]) != "-") spill_dir = argv[9];
+    string budget = "";
+    if (argc > 10 && string(argv[10]) != "-") budget = argv[10];
+    int rollouts = 0;
+    if (argc > 11) rollouts = std::stoi(argv[11], &pos);
+    string snapshot = "";
+    if (argc > 12 && string(argv[12]) != "-") snapshot = argv[12];
 
 
     int training_steps = 10000;
-    int max_memory_used = 0;
-    int load_period = 250;
-    int MIN_VMS = 1;
-    int MAX_VMS = 20;
-    float epsilon = 0.7;
     string CONF_FILE = "./model_parameters/mdp_small_1.json";
     ModelConf conf(CONF_FILE);
 
-    ComplexScenario scenario(5000, load_period, 10, MIN_VMS, MAX_VMS);
-    FiniteMDPModel model(conf.get_model_conf(), seed);
-    model.set_state(scenario.get_current_measurements());
-    float total_reward = 0.0;
-    pair<string, int> action;
-    //TRAIN THE MODEL
-
-    for (int time = 0; time < training_steps; time++){
-
-        float x = model.unif(model.eng);
-        if (x < epsilon)
-        {
-            action = randomchoice(model.get_legal_actions(), model);
-        }
-        else
-        {
-            action = model.suggest_action();
-        }
-        float reward = scenario.execute_action(action);
-        json meas = scenario.get_current_measurements();
-        model.update(action, meas, reward);
-        if (time % 500 == 1){
-            model.value_iteration(0.1);
-        }
+    bool use_snapshot = !snapshot.empty() && std::ifstream(snapshot).good();
+    FiniteMDPModel model(use_snapshot ? json({}) : conf.get_model_conf(), seed);
+    model.set_num_threads(num_threads);
+    model.infinite_solver = solver;
+    if (use_snapshot && !model.load_snapshot(snapshot))
+        return 1;
+    if (!use_snapshot){
+        train_model(model, training_steps); //TRAIN THE MODEL
+        if (!snapshot.empty() && !model.save_snapshot(snapshot))
+            cout << "Cannot write the snapshot " << snapshot << endl;
     }
-    model.initial_state_num = model.current_state_num;
-    int count0=0;
-    int count1=0;
-    for (int i=0;i< model.states.size();i++){
-        for (int j=0;j< model.states[i].qstates.size();j++){
-            for (int k=0;k< model.states[i].qstates[j].transitions.size();k++){
-                if (model.states[i].qstates[j].get_transition(k)>0){
-                    model.states[i].qstates[j].trans.push_back(model.states[i].qstates[j].get_transition(k));
-                    model.states[i].qstates[j].transtate.push_back(k);
-                    count1++;
-                }
-                else {
-                    count0++;
-                }
-            }
+    model.set_checkpoint_codec(codec, max_error);
+    model.action_stack.spill_to(spill_dir);
+    if (!budget.empty()){
+        std::size_t unit = 0;
+        double amount = -1;
+        try { amount = std::stod(budget, &unit); } catch (const std::exception &e) {}
+        string suffix = budget.substr(unit);
+        double bytes = (suffix == "KB") ? 1e3 : (suffix == "MB") ? 1e6 : (suffix == "GB") ? 1e9 : (suffix == "B") ? 1 : 0;
+        if (amount < 0 || (bytes == 0 && !suffix.empty())){
+            cout << "Invalid budget " << budget << "." << endl;
+            return usage(argv[0]);
         }
+        if (bytes > 0) //bytes, divided by the size of one checkpoint with the chosen codec
+            model.checkpoint_budget = amount * bytes / model.finite_stack.slot_bytes();
+        else
+            model.checkpoint_budget = amount;
+        if (model.checkpoint_budget == 0)
+            cout << "Warning: a budget of " << budget << " holds no checkpoint (one takes " << model.finite_stack.slot_bytes()
+                 << " bytes), the revolve method will recompute every step from the start" << endl;
     }
     model.discount = gama;
     cout << "model discount " << model.discount << endl; 
     /*for (int i=0;i< model.states.size();i++){
         for (int j=0;j< model.states[i].qstates.size();j++){
-            for (int k=0; k < model.states[i].qstates[j].transtate.size(); k++){
-                cout << "State " << i << " Qstate " << j << " probability = " << model.states[i].qstates[j].trans[k] << " to " << model.states[i].qstates[j].transtate[k] << endl;
+            TransitionStore &ts = model.transition_store;
+            for (int k=ts.begin(model.states[i].qstates[j].row); k < ts.end(model.states[i].qstates[j].row); k++){
+                cout << "State " << i << " Qstate " << j << " probability = " << ts.probabilities[k] << " to " << ts.successors[k] << endl;
             }
         }
     }*/
 
-    model.runAlgorithm(algo, horizon);
+    if (rollouts > 0)
+        model.runRollouts(algo, horizon, rollouts, seed);
+    else
+        model.runAlgorithm(algo, horizon);
 }
\ No newline at end of file